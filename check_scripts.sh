@@ -8,8 +8,10 @@ alias shellcheck='docker run --rm -it -v $(pwd):/mnt nlknguyen/alpine-shellcheck
 
 shellcheck --version
 shellcheck  **/*.sh                     \
-            onbuild/auto_update_hosts   \
             onbuild/get_hosts           \
+            onbuild/hosts_registry      \
+            onbuild/hosts_registry_event \
+            onbuild/register_node       \
             onbuild/mpi_bootstrap       \
 
 echo "=> No styling trouble found"
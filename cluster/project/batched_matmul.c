@@ -0,0 +1,264 @@
+/*
+ * Batched many-small-matrix multiplication using MPI (MPICH)
+ * -----------------------------------------------------------
+ *  - Purpose: Throughput mode for streams of thousands of independent
+ *    small products (orders 64–512), where one mpirun per product would be
+ *    dominated by startup cost.
+ *  - Features:
+ *      • Job list of (A, B) products, given as "<count> <order>" lines
+ *      • Operands are generated from the job index (integers in [1,10]),
+ *        so moving a job between ranks only moves its index
+ *      • Initial split of the job list in ranges of equal estimated work
+ *        (order^3), then decentralized work stealing (work_stealing.h): an
+ *        idle rank asks a random victim for work, the victim answers at its
+ *        next batch boundary with the upper half of its remaining range.
+ *        There is no master handing out jobs.
+ *      • Termination detected with a single completed-jobs counter in an
+ *        MPI RMA window (MPI_Accumulate / MPI_Fetch_and_op)
+ *      • Consecutive jobs of the same order are multiplied together in one
+ *        kernel call, up to BATCH_ELEMS elements per operand
+ *      • Throughput reported in products/sec, plus per-rank busy time and
+ *        steal counts to show the load balance
+ *
+ *  Build & run examples
+ *  --------------------
+ *      mpicc -O3 -o batched_matmul batched_matmul.c work_stealing.c
+ *      mpirun -np 8 ./batched_matmul              # built-in job mix
+ *      mpirun -np 8 ./batched_matmul jobs.txt     # job list read by rank 0
+ *
+ *  Job list example (jobs.txt)
+ *  ---------------------------
+ *      1000 64
+ *      500 128
+ *      40 512
+ *
+ *  Notes
+ *  -----
+ *      • The reported checksum is the sum of all elements of all products;
+ *        it does not depend on the number of processes or on the stealing.
+ */
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "work_stealing.h"
+
+#define MAX_VAL 10
+#define MIN_VAL 1
+#ifndef BATCH_ELEMS
+#define BATCH_ELEMS (1 << 20)
+#endif
+#define MAX_GROUPS 64
+
+/* Built-in job mix used when no job list is given */
+static const int default_counts[] = {1000, 500, 200, 40};
+static const int default_orders[] = {64, 128, 256, 512};
+
+typedef struct {
+    long total;          /* number of jobs in the list           */
+    int *order;          /* order of job i, sorted ascending     */
+    long long checksum;  /* sum of all elements of all products  */
+    WorkSteal ws;        /* jobs still owned, steal protocol     */
+} Scheduler;
+
+/*------------------------------------------------------------*/
+static void fill_random_seeded(int *mat, int elements, unsigned seed) {
+    for (int i = 0; i < elements; ++i) {
+        mat[i] = rand_r(&seed) % (MAX_VAL - MIN_VAL + 1) + MIN_VAL;
+    }
+}
+
+/* Multiply count independent n x n products stored back to back */
+static void batch_multiply(const int *A, const int *B, int *C, int count, int n) {
+    size_t elems = (size_t)n * n;
+    memset(C, 0, (size_t)count * elems * sizeof(int));
+    for (int b = 0; b < count; ++b) {
+        const int *a = A + b * elems, *bm = B + b * elems;
+        int *c = C + b * elems;
+        for (int i = 0; i < n; ++i) {
+            for (int k = 0; k < n; ++k) {
+                int a_ik = a[i * n + k];
+                for (int j = 0; j < n; ++j) {
+                    c[i * n + j] += a_ik * bm[k * n + j];
+                }
+            }
+        }
+    }
+}
+
+/* Read "<count> <order>" lines; returns number of groups, -1 on error or
+   -2 if the list has more than MAX_GROUPS lines */
+static int read_job_list(const char *path, int *counts, int *orders) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    int groups = 0, count, order;
+    while (fscanf(f, "%d %d", &count, &order) == 2) {
+        if (count < 0 || order <= 0 || groups == MAX_GROUPS) {
+            fclose(f);
+            return groups == MAX_GROUPS ? -2 : -1;
+        }
+        counts[groups] = count;
+        orders[groups] = order;
+        ++groups;
+    }
+    fclose(f);
+    return groups;
+}
+
+static int compare_int(const void *a, const void *b) {
+    return (*(const int *)a > *(const int *)b) - (*(const int *)a < *(const int *)b);
+}
+
+/* Run the owned range batch by batch until it is empty */
+static void run_owned_jobs(Scheduler *s, int *A, int *B, int *C) {
+    WorkSteal *ws = &s->ws;
+    while (ws->lo < ws->hi) {
+        int n = s->order[ws->lo];
+        long elems = (long)n * n;
+        long fit = BATCH_ELEMS / elems > 0 ? BATCH_ELEMS / elems : 1;
+        long first = ws->lo, last = ws->lo;
+        while (last < ws->hi && last - first < fit && s->order[last] == n) ++last;
+        /* Claim the batch before computing so that it cannot be stolen */
+        ws->lo = last;
+
+        int count = (int)(last - first);
+        for (int b = 0; b < count; ++b) {
+            fill_random_seeded(A + b * elems, (int)elems, (unsigned)(2 * (first + b)));
+            fill_random_seeded(B + b * elems, (int)elems, (unsigned)(2 * (first + b) + 1));
+        }
+        batch_multiply(A, B, C, count, n);
+        for (long e = 0; e < count * elems; ++e) s->checksum += C[e];
+
+        ws_finished(ws, count);
+        ws_serve(ws);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    MPI_Init(&argc, &argv);
+
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    /* Job list: rank 0 reads it, everyone gets the group table */
+    int counts[MAX_GROUPS], orders[MAX_GROUPS];
+    int groups = 0;
+    if (rank == 0) {
+        if (argc > 1) {
+            groups = read_job_list(argv[1], counts, orders);
+            if (groups == -2)
+                fprintf(stderr, "Error: job list \"%s\" has more than %d lines; merge lines of the same order.\n",
+                        argv[1], MAX_GROUPS);
+            else if (groups < 0)
+                fprintf(stderr, "Error: cannot read job list \"%s\".\n", argv[1]);
+        } else {
+            groups = (int)(sizeof(default_counts) / sizeof(default_counts[0]));
+            memcpy(counts, default_counts, sizeof(default_counts));
+            memcpy(orders, default_orders, sizeof(default_orders));
+        }
+    }
+    MPI_Bcast(&groups, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (groups <= 0) MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    MPI_Bcast(counts, groups, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(orders, groups, MPI_INT, 0, MPI_COMM_WORLD);
+
+    Scheduler s;
+    memset(&s, 0, sizeof(s));
+    int max_order = 0;
+    for (int g = 0; g < groups; ++g) {
+        s.total += counts[g];
+        if (orders[g] > max_order) max_order = orders[g];
+    }
+    s.order = (int *)malloc((s.total > 0 ? s.total : 1) * sizeof(int));
+    if (!s.order) {
+        fprintf(stderr, "Rank %d: Memory allocation failure.\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    long pos = 0;
+    for (int g = 0; g < groups; ++g)
+        for (int c = 0; c < counts[g]; ++c) s.order[pos++] = orders[g];
+    /* Sorted by order so that consecutive jobs can share a kernel call */
+    qsort(s.order, s.total, sizeof(int), compare_int);
+
+    /* Initial ranges of equal estimated work */
+    double work = 0.0;
+    for (long j = 0; j < s.total; ++j) work += (double)s.order[j] * s.order[j] * s.order[j];
+    double acc = 0.0;
+    long lo = -1, hi = s.total;
+    for (long j = 0; j < s.total; ++j) {
+        int owner = (int)(acc / work * size);
+        if (owner > size - 1) owner = size - 1;
+        if (owner == rank && lo < 0) lo = j;
+        if (owner > rank) { hi = j; break; }
+        acc += (double)s.order[j] * s.order[j] * s.order[j];
+    }
+    if (lo < 0) lo = hi;
+
+    long elems = (long)max_order * max_order;
+    long batch_elems = elems > BATCH_ELEMS ? elems : BATCH_ELEMS;
+    int *A = (int *)malloc(batch_elems * sizeof(int));
+    int *B = (int *)malloc(batch_elems * sizeof(int));
+    int *C = (int *)malloc(batch_elems * sizeof(int));
+    if (!A || !B || !C) {
+        fprintf(stderr, "Rank %d: Memory allocation failure.\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+
+    ws_init(&s.ws, MPI_COMM_WORLD, lo, hi, s.total, 1);
+
+    /* -------------------------------------------------------- */
+    /*        Start timing the whole batch                      */
+    /* -------------------------------------------------------- */
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t0 = MPI_Wtime();
+    double busy = 0.0;
+
+    for (;;) {
+        double tb = MPI_Wtime();
+        run_owned_jobs(&s, A, B, C);
+        busy += MPI_Wtime() - tb;
+        /* A stolen range becomes the owned one */
+        if (ws_steal(&s.ws, &lo, &hi) < 0) break;
+        s.ws.lo = lo;
+        s.ws.hi = hi;
+    }
+    ws_drain(&s.ws);
+
+    double local_elapsed = MPI_Wtime() - t0;
+
+    /* -------------------------------------------------------- */
+    /*        End of batch                                      */
+    /* -------------------------------------------------------- */
+
+    double elapsed, busy_min, busy_max;
+    long long checksum;
+    int steals;
+    MPI_Reduce(&local_elapsed, &elapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&busy, &busy_min, 1, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&busy, &busy_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&s.checksum, &checksum, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&s.ws.steals, &steals, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    long *done = rank == 0 ? (long *)malloc(size * sizeof(long)) : NULL;
+    MPI_Gather(&s.ws.done, 1, MPI_LONG, done, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        printf("Batched multiplication of %ld products completed in %.6f seconds across %d process(es).\n",
+               s.total, elapsed, size);
+        printf("Throughput: %.1f products/sec, checksum %lld.\n", s.total / elapsed, checksum);
+        printf("Busy time per rank: min %.6f s, max %.6f s; %d successful steal(s).\n", busy_min, busy_max, steals);
+        for (int r = 0; r < size; ++r) printf("  rank %d: %ld products\n", r, done[r]);
+        free(done);
+    }
+
+    ws_free(&s.ws);
+    free(A);
+    free(B);
+    free(C);
+    free(s.order);
+    MPI_Finalize();
+    return 0;
+}
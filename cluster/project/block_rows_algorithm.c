@@ -6,6 +6,17 @@
  *  - Features:
  *      • Random initialization of A and B with integers in [1,10]
  *      • Block‑row distribution of A, full broadcast of B
+ *      • Optional compressed broadcast of B (CT_MODE=on|auto, see
+ *        compressed_transport.h)
+ *      • Aligned, huge-page backed, NUMA-local buffers (matrix_alloc.h)
+ *      • Speed-aware distribution (argv[2]): rows per rank proportional to
+ *        the rank's multiply-add rate, measured by a short probe ("probe")
+ *        or taken from the previous run ("history"), sent with
+ *        MPI_Scatterv / MPI_Gatherv; "even" (default) splits N evenly
+ *      • Optional row-chunk stealing (argv[3] = "steal", work_stealing.h):
+ *        an idle rank asks a random victim for the upper half of its
+ *        remaining rows, computes them and sends the C rows back to their
+ *        owner
  *      • Pure computation timed with MPI_Wtime (excludes I/O & init)
  *      • Matrix order N must be a multiple of 8; default 1024 (can be
  *        overridden at compile‑time with -DN=<size> or at runtime by
@@ -13,14 +24,28 @@
  *
  *  Build & run examples
  *  --------------------
- *      mpicc -O3 -DN=1024 -o matmul mpi_matrix_multiply.c
+ *      mpicc -O3 -DN=1024 -o matmul block_rows_algorithm.c compressed_transport.c matrix_alloc.c work_stealing.c
  *      mpirun -np 8 ./matmul            # uses N from -D or default
  *      mpirun -np 4 ./matmul 2048       # overrides to 2048 at runtime
+ *      mpirun -np 4 ./matmul 2048 probe # rows proportional to probed speed
+ *      mpirun -np 4 ./matmul 2048 history steal
+ *                                       # last run's speeds, then stealing
+ *      mpirun -np 4 -env CT_MODE auto ./matmul
+ *                                       # compresses B if it pays off
+ *      mpicc -O3 -DPERF_REGIONS -o matmul block_rows_algorithm.c compressed_transport.c matrix_alloc.c work_stealing.c perf_regions.c -lm
+ *                                       # adds hardware counters per phase
  *
  *  Notes
  *  -----
- *      • MATRIX_SIZE must be divisible by the number of processes; otherwise the
- *        program aborts.
+ *      • N need not be divisible by the number of processes; the even split
+ *        gives the remainder rows to the first ranks.
+ *      • "probe" and "history" runs write the speed the ranks achieved to
+ *        SPEEDS_FILE (block_rows_speeds.txt in the working directory,
+ *        -DSPEEDS_FILE to change it), one "<processor name> <multiply-adds/s>"
+ *        line per host, averaged over the ranks on that host. A "history"
+ *        run gives every rank the speed of its host, so the file survives a
+ *        different rank placement; if a host is missing it probes instead.
+ *      • Stealing moves STEAL_CHUNK rows (default 8) at least per claim.
  *      • The reported time is the maximum across all ranks so it reflects
  *        total wall‑clock runtime.
  */
@@ -28,13 +53,48 @@
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
+#include "perf_regions.h"
+#include "compressed_transport.h"
+#include "matrix_alloc.h"
+#include "work_stealing.h"
+
 #define MAX_VAL 10
 #define MIN_VAL 1
 #ifndef MATRIX_SIZE
 #define MATRIX_SIZE 1024
 #endif
+#ifndef SPEEDS_FILE
+#define SPEEDS_FILE "block_rows_speeds.txt"
+#endif
+#ifndef STEAL_CHUNK
+#define STEAL_CHUNK 8
+#endif
+#define PROBE_ORDER 256
+#define PROBE_SECONDS 0.05
+
+#define TAG_STEAL_ROWS 1
+#define TAG_RESULT 2
+
+enum { BALANCE_EVEN, BALANCE_PROBE, BALANCE_HISTORY };
+static const char *balance_names[] = {"even", "probe", "history"};
+
+/* Rows of this rank and the state of the optional stealing */
+typedef struct {
+    int n;
+    int first;                  /* global index of local row 0           */
+    const int *A, *B;
+    int *C;
+    long rows_done;             /* rows computed here, own or stolen     */
+    double busy;
+    WorkSteal ws;               /* global rows still owned, steal state  */
+    MPI_Request *reqs;          /* loaned rows coming back, results out  */
+    int nreqs, max_reqs;
+    int **stolen;               /* buffers of the stolen rows            */
+    int nstolen;
+} Rows;
 
 /*------------------------------------------------------------*/
 static void fill_random(int *mat, int elements) {
@@ -43,44 +103,255 @@ static void fill_random(int *mat, int elements) {
     }
 }
 
+/* C (rows x n) += A (rows x n) * B (n x n) */
+static void multiply_rows(const int *A, const int *B, int *C, int rows, int n) {
+    for (int i = 0; i < rows; ++i) {
+        for (int k = 0; k < n; ++k) {
+            int a_ik = A[i * n + k];
+            for (int j = 0; j < n; ++j) {
+                C[i * n + j] += a_ik * B[k * n + j];
+            }
+        }
+    }
+}
+
+/*------------------------------------------------------------*/
+/* Speeds and row split                                       */
+/*------------------------------------------------------------*/
+
+/* Multiply-adds per second of this rank on a PROBE_ORDER product */
+static double probe_speed(void) {
+    int m = PROBE_ORDER, reps = 0;
+    int *a = malloc((size_t)m * m * sizeof(int)), *b = malloc((size_t)m * m * sizeof(int));
+    int *c = calloc((size_t)m * m, sizeof(int));
+    if (!a || !b || !c) {
+        free(a); free(b); free(c);
+        return 1.0;
+    }
+    fill_random(a, m * m);
+    fill_random(b, m * m);
+    double t0 = MPI_Wtime(), t;
+    do {
+        multiply_rows(a, b, c, m, m);
+        ++reps;
+    } while ((t = MPI_Wtime() - t0) < PROBE_SECONDS);
+    free(a); free(b); free(c);
+    return (double)reps * m * m * m / t;
+}
+
+#define HOST(hosts, r) ((hosts) + (size_t)(r) * MPI_MAX_PROCESSOR_NAME)
+
+/* Speeds of the previous run, looked up by the processor name of each rank
+   in hosts; returns 0 unless every rank's host has an entry */
+static int read_speeds(const char *path, const char *hosts, double *speed, int size) {
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    for (int r = 0; r < size; ++r) speed[r] = 0.0;
+    char name[256];
+    double v;
+    while (fscanf(f, "%255s %lf", name, &v) == 2) {
+        if (v <= 0.0) continue;
+        for (int r = 0; r < size; ++r)
+            if (strcmp(name, HOST(hosts, r)) == 0) speed[r] = v;
+    }
+    fclose(f);
+    int found = 1;
+    for (int r = 0; r < size; ++r) found &= speed[r] > 0.0;
+    return found;
+}
+
+/* One line per host with the mean speed of the ranks it ran */
+static void write_speeds(const char *path, const char *hosts, const double *speed, int size) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Warning: cannot write %s.\n", path);
+        return;
+    }
+    for (int r = 0; r < size; ++r) {
+        int first = 1, ranks = 0;
+        double total = 0.0;
+        for (int p = 0; p < size; ++p) {
+            if (strcmp(HOST(hosts, p), HOST(hosts, r)) != 0) continue;
+            first &= p >= r;
+            total += speed[p];
+            ++ranks;
+        }
+        if (first) fprintf(f, "%s %.6g\n", HOST(hosts, r), total / ranks);
+    }
+    fclose(f);
+}
+
+/* Rows per rank proportional to speed; leftover rows go to the largest
+   fractional shares */
+static void split_rows(const double *speed, int size, int n, int *rows) {
+    double total = 0.0;
+    for (int r = 0; r < size; ++r) total += speed[r];
+    int given = 0;
+    for (int r = 0; r < size; ++r) {
+        rows[r] = (int)(n * speed[r] / total);
+        given += rows[r];
+    }
+    while (given < n) {
+        int best = 0;
+        double best_frac = -1.0;
+        for (int r = 0; r < size; ++r) {
+            double frac = n * speed[r] / total - rows[r];
+            if (frac > best_frac) {
+                best_frac = frac;
+                best = r;
+            }
+        }
+        rows[best]++;
+        given++;
+    }
+}
+
+/*------------------------------------------------------------*/
+/* Row-chunk stealing (work_stealing.h)                       */
+/*------------------------------------------------------------*/
+
+static void add_request(Rows *r, MPI_Request req) {
+    if (r->nreqs == r->max_reqs) {
+        r->max_reqs = r->max_reqs ? 2 * r->max_reqs : 16;
+        r->reqs = realloc(r->reqs, r->max_reqs * sizeof(MPI_Request));
+        if (!r->reqs) MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    r->reqs[r->nreqs++] = req;
+}
+
+/* Lend hook: the thief gets the A rows of [lo, hi) and sends their C rows
+   back straight into local_C */
+static void lend_rows(void *ctx, int thief, long lo, long hi) {
+    Rows *r = ctx;
+    size_t offset = (size_t)(lo - r->first) * r->n;
+    int elems = (int)(hi - lo) * r->n;
+    MPI_Request req;
+    MPI_Send(r->A + offset, elems, MPI_INT, thief, TAG_STEAL_ROWS, MPI_COMM_WORLD);
+    MPI_Irecv(r->C + offset, elems, MPI_INT, thief, TAG_RESULT, MPI_COMM_WORLD, &req);
+    add_request(r, req);
+}
+
+/* Compute rows stolen from victim and send their C rows back */
+static void run_stolen_rows(Rows *r, int victim, int count) {
+    int n = r->n;
+    int *buf = matrix_alloc(2 * (size_t)count * n * sizeof(int));
+    int **grown = realloc(r->stolen, (r->nstolen + 1) * sizeof(int *));
+    if (!buf || !grown) {
+        fprintf(stderr, "Rank %d: Memory allocation failure.\n", r->ws.rank);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    r->stolen = grown;
+    r->stolen[r->nstolen++] = buf;
+    MPI_Recv(buf, count * n, MPI_INT, victim, TAG_STEAL_ROWS, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+    double tb = MPI_Wtime();
+    multiply_rows(buf, r->B, buf + (size_t)count * n, count, n);
+    r->busy += MPI_Wtime() - tb;
+    ws_finished(&r->ws, count);
+
+    MPI_Request req;
+    MPI_Isend(buf + (size_t)count * n, count * n, MPI_INT, victim, TAG_RESULT, MPI_COMM_WORLD, &req);
+    add_request(r, req);
+}
+
+/* Compute the owned rows chunk by chunk until none is left */
+static void run_owned_rows(Rows *r) {
+    WorkSteal *ws = &r->ws;
+    while (ws->lo < ws->hi) {
+        long first = ws->lo, count = ws->hi - ws->lo < STEAL_CHUNK ? ws->hi - ws->lo : STEAL_CHUNK;
+        /* Claim the chunk before computing so that it cannot be lent */
+        ws->lo += count;
+        size_t offset = (size_t)(first - r->first) * r->n;
+        double tb = MPI_Wtime();
+        multiply_rows(r->A + offset, r->B, r->C + offset, (int)count, r->n);
+        r->busy += MPI_Wtime() - tb;
+        ws_finished(ws, count);
+        ws_serve(ws);
+    }
+}
+
 int main(int argc, char *argv[]) {
     MPI_Init(&argc, &argv);
+    PR_INIT();
 
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
-    /* Determine matrix order */
+    /* Determine matrix order, balance mode and stealing */
     int n=MATRIX_SIZE;
     if (argc > 1) {
         n= atoi(argv[1]);
     }
+    int balance = BALANCE_EVEN;
+    if (argc > 2) {
+        for (balance = 0; balance < 3 && strcmp(argv[2], balance_names[balance]) != 0; ++balance) {}
+        if (balance == 3) {
+            if (rank == 0) fprintf(stderr, "Error: balance mode must be even, probe or history.\n");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+    }
+    int steal = argc > 3 && strcmp(argv[3], "steal") == 0;
 
     if (n % 8 != 0) {
         if (rank == 0) fprintf(stderr, "Error: N (%d) must be a multiple of 8.\n", n);
         MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
     }
-    if (n % size != 0) {
-        if (rank == 0) fprintf(stderr, "Error: N (%d) must be divisible by number of processes (%d).\n", n, size);
+
+    /* Rows per rank */
+    double *speed = malloc(size * sizeof(double));
+    int *rows = malloc(size * sizeof(int)), *counts = malloc(size * sizeof(int)), *displs = malloc(size * sizeof(int));
+    if (!speed || !rows || !counts || !displs) {
+        fprintf(stderr, "Rank %d: Memory allocation failure.\n", rank);
         MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
     }
-
-    int rows_per_proc = n / size;
-    size_t block_elems = (size_t)rows_per_proc * n;
+    /* Speeds are kept per host, so rank 0 needs every rank's processor name */
+    char *hosts = NULL;
+    if (balance != BALANCE_EVEN) {
+        char host[MPI_MAX_PROCESSOR_NAME] = "";
+        int len;
+        MPI_Get_processor_name(host, &len);
+        if (rank == 0 && !(hosts = malloc((size_t)size * MPI_MAX_PROCESSOR_NAME))) {
+            fprintf(stderr, "Root: Memory allocation failure.\n");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        MPI_Gather(host, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, hosts, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, 0,
+                   MPI_COMM_WORLD);
+    }
+    int history = 0;
+    if (balance == BALANCE_HISTORY) {
+        if (rank == 0) history = read_speeds(SPEEDS_FILE, hosts, speed, size);
+        MPI_Bcast(&history, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        if (history) MPI_Bcast(speed, size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        else if (rank == 0) fprintf(stderr, "Warning: no usable %s, probing instead.\n", SPEEDS_FILE);
+    }
+    if (balance == BALANCE_EVEN) {
+        for (int r = 0; r < size; ++r) speed[r] = 1.0;
+    } else if (!history) {
+        double mine = probe_speed();
+        MPI_Allgather(&mine, 1, MPI_DOUBLE, speed, 1, MPI_DOUBLE, MPI_COMM_WORLD);
+    }
+    split_rows(speed, size, n, rows);
+    for (int r = 0, row = 0; r < size; row += rows[r], ++r) {
+        counts[r] = rows[r] * n;
+        displs[r] = row * n;
+    }
+    int first_row = displs[rank] / n, my_rows = rows[rank];
+    size_t block_elems = (size_t)my_rows * n;
 
     /* Root allocates full matrices; others just what they need */
     int *A = NULL, *B = NULL, *C = NULL;
-    int *local_A = (int *)malloc(block_elems * sizeof(int));
-    int *local_C = (int *)calloc(block_elems, sizeof(int));
+    int *local_A = matrix_alloc(block_elems * sizeof(int));
+    int *local_C = matrix_alloc(block_elems * sizeof(int));
     if (!local_A || !local_C) {
         fprintf(stderr, "Rank %d: Memory allocation failure.\n", rank);
         MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
     }
 
     if (rank == 0) {
-        A = (int *)malloc((size_t)n * n * sizeof(int));
-        B = (int *)malloc((size_t)n * n * sizeof(int));
-        C = (int *)malloc((size_t)n * n * sizeof(int));
+        A = matrix_alloc((size_t)n * n * sizeof(int));
+        B = matrix_alloc((size_t)n * n * sizeof(int));
+        C = matrix_alloc((size_t)n * n * sizeof(int));
         if (!A || !B || !C) {
             fprintf(stderr, "Root: Memory allocation failure.\n");
             MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
@@ -92,12 +363,29 @@ int main(int argc, char *argv[]) {
 
     /* Broadcast B to everyone */
     if (rank != 0) {
-        B = (int *)malloc((size_t)n * n * sizeof(int));
+        B = matrix_alloc((size_t)n * n * sizeof(int));
     }
-    MPI_Bcast(B, n * n, MPI_INT, 0, MPI_COMM_WORLD);
+    CtLink linkB;
+    ct_link_init(&linkB, "B", MPI_COMM_WORLD);
+    PR_BEGIN(PR_COMM);
+    ct_bcast(&linkB, B, n * n, 0);
 
     /* Scatter rows of A */
-    MPI_Scatter(A, (int)block_elems, MPI_INT, local_A, (int)block_elems, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Scatterv(A, counts, displs, MPI_INT, local_A, (int)block_elems, MPI_INT, 0, MPI_COMM_WORLD);
+    PR_END(PR_COMM);
+
+    Rows r;
+    memset(&r, 0, sizeof(r));
+    r.n = n;
+    r.first = first_row;
+    r.A = local_A;
+    r.B = B;
+    r.C = local_C;
+    if (steal) {
+        ws_init(&r.ws, MPI_COMM_WORLD, first_row, first_row + my_rows, n, STEAL_CHUNK);
+        r.ws.lend = lend_rows;
+        r.ws.ctx = &r;
+    }
 
     /* -------------------------------------------------------- */
     /*        Start timing JUST the multiplication phase        */
@@ -105,14 +393,25 @@ int main(int argc, char *argv[]) {
     MPI_Barrier(MPI_COMM_WORLD);
     double t0 = MPI_Wtime();
 
-    for (int i = 0; i < rows_per_proc; ++i) {
-        for (int k = 0; k < n; ++k) {
-            int a_ik = local_A[i * n + k];
-            for (int j = 0; j < n; ++j) {
-                local_C[i * n + j] += a_ik * B[k * n + j];
-            }
+    PR_BEGIN(PR_COMPUTE);
+    if (!steal) {
+        multiply_rows(local_A, B, local_C, my_rows, n);
+        r.busy = MPI_Wtime() - t0;
+        r.rows_done = my_rows;
+    } else {
+        for (;;) {
+            run_owned_rows(&r);
+            long lo, hi;
+            int victim = ws_steal(&r.ws, &lo, &hi);
+            if (victim < 0) break;
+            if (hi > lo) run_stolen_rows(&r, victim, (int)(hi - lo));
         }
+        ws_drain(&r.ws);
+        MPI_Waitall(r.nreqs, r.reqs, MPI_STATUSES_IGNORE);
+        r.rows_done = r.ws.done;
     }
+    PR_END(PR_COMPUTE);
+    PR_OPS(PR_COMPUTE, 2.0 * r.rows_done * n * n);
 
     double local_elapsed = MPI_Wtime() - t0;
 
@@ -124,23 +423,59 @@ int main(int argc, char *argv[]) {
     double elapsed;
     MPI_Reduce(&local_elapsed, &elapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
 
-    MPI_Gather(local_C, (int)block_elems, MPI_INT, C, (int)block_elems, MPI_INT, 0, MPI_COMM_WORLD);
+    PR_BEGIN(PR_COMM);
+    MPI_Gatherv(local_C, (int)block_elems, MPI_INT, C, counts, displs, MPI_INT, 0, MPI_COMM_WORLD);
+    PR_END(PR_COMM);
+
+    /* Achieved speed of every rank, kept for the next "history" run */
+    double achieved = r.busy > 0.0 ? (double)r.rows_done * n * n / r.busy : 0.0, busy_min, busy_max;
+    long *done = rank == 0 ? malloc(size * sizeof(long)) : NULL;
+    int steals;
+    MPI_Gather(&achieved, 1, MPI_DOUBLE, speed, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    MPI_Gather(&r.rows_done, 1, MPI_LONG, done, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&r.busy, &busy_min, 1, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&r.busy, &busy_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&r.ws.steals, &steals, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    matrix_alloc_report(MPI_COMM_WORLD, "block rows");
 
     if (rank == 0) {
         printf("Matrix multiplication %dx%d completed in %.6f seconds across %d process(es).\n", n, n, elapsed, size);
+        if (balance != BALANCE_EVEN || steal) {
+            printf("Balance: %s%s%s; busy time per rank: min %.6f s, max %.6f s; %d successful steal(s).\n",
+                   balance_names[balance], balance == BALANCE_HISTORY && !history ? " (probed)" : "",
+                   steal ? " + steal" : "", busy_min, busy_max, steals);
+            for (int p = 0; p < size; ++p)
+                printf("  rank %d: %d rows assigned, %ld computed, %.3f GMAC/s\n", p, rows[p], done[p],
+                       speed[p] / 1e9);
+        }
+        int all_measured = balance != BALANCE_EVEN;
+        for (int p = 0; p < size; ++p) all_measured &= speed[p] > 0.0;
+        if (all_measured) write_speeds(SPEEDS_FILE, hosts, speed, size);
         /* Optional: verify correctness or write C to disk */
-        free(A);
-        free(B);
-        free(C);
+        matrix_free(A);
+        matrix_free(B);
+        matrix_free(C);
+        free(done);
+        free(hosts);
     } else {
-        free(B);
+        matrix_free(B);
     }
 
-    free(local_A);
-    free(local_C);
+    ct_link_report(&linkB);
+    ct_link_free(&linkB);
+    PR_REPORT(MPI_COMM_WORLD, "block rows");
+
+    if (steal) ws_free(&r.ws);
+    for (int i = 0; i < r.nstolen; ++i) matrix_free(r.stolen[i]);
+    free(r.stolen);
+    free(r.reqs);
+    matrix_free(local_A);
+    matrix_free(local_C);
+    free(speed);
+    free(rows);
+    free(counts);
+    free(displs);
     MPI_Finalize();
     return 0;
 }
-
-
-
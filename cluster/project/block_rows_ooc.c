@@ -0,0 +1,406 @@
+/*
+ * Out-of-core block-row matrix multiplication using MPI (MPICH)
+ * -----------------------------------------------------------
+ *  - Purpose: Run the block-row multiplication at orders whose operands do
+ *    not fit in the containers' memory (mem_limit: 128M), e.g. N=16384,
+ *    by keeping them in local scratch files and streaming tiles.
+ *  - Features:
+ *      • Same decomposition as block_rows_algorithm.c: each rank owns
+ *        N / size rows of A and C and needs all of B
+ *      • A rows are generated by their owner, B is generated by rank 0 and
+ *        broadcast in panels; both are written to per-rank scratch files
+ *        (integers in [1,10], a function of the element position, so the
+ *        result does not depend on the number of processes)
+ *      • C is computed one row band at a time: the A band is read once, B
+ *        is streamed in panels of rows, and the finished C band is written
+ *        back to its scratch file
+ *      • A helper I/O thread serves the reads and writes in order while the
+ *        main thread computes: the next A band and the next B panel are
+ *        read ahead into a second buffer, C bands are written behind
+ *      • Peak memory of the tiles stays within a budget given in MiB; band
+ *        height and panel depth are derived from it
+ *      • Reports compute time, time stalled on I/O, bytes moved and a
+ *        checksum of C, maximum / total across ranks
+ *
+ *  Build & run examples
+ *  --------------------
+ *      mpicc -O3 -o block_rows_ooc block_rows_ooc.c -lpthread
+ *      mpirun -np 4 ./block_rows_ooc 16384           # 64 MiB of tiles, /tmp
+ *      mpirun -np 4 ./block_rows_ooc 16384 32 /scratch
+ *
+ *  Notes
+ *  -----
+ *      • N must be divisible by the number of processes.
+ *      • MPI is initialised at MPI_THREAD_FUNNELED because of the I/O thread;
+ *        only the main thread calls MPI.
+ *      • Scratch files are <dir>/ooc_{A,B,C}.<rank>; A and B are removed at
+ *        the end, C is left in place as the result (the rows of that rank).
+ *      • Each rank needs (N / size + N) * N * 4 bytes of scratch space plus
+ *        its C rows.
+ *      • B is read once per C band, so a larger budget (taller bands)
+ *        directly reduces the I/O volume.
+ */
+
+#include <mpi.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "perf_regions.h"
+
+#define MAX_VAL 10
+#define MIN_VAL 1
+#ifndef MATRIX_SIZE
+#define MATRIX_SIZE 16384
+#endif
+#define DEFAULT_BUDGET_MB 64
+#define QUEUE_SLOTS 8
+
+/*------------------------------------------------------------*/
+/* Helper I/O thread                                          */
+/*------------------------------------------------------------*/
+
+typedef struct {
+    int fd, write, error;
+    char *buf;
+    size_t bytes;
+    off_t offset;
+    int pending;                 /* submitted and not yet waited for */
+    volatile int done;
+} IoReq;
+
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work, finished;
+    IoReq *queue[QUEUE_SLOTS];
+    int head, tail, stop;
+    double busy;                 /* seconds spent in pread / pwrite */
+    double stalled;              /* seconds the main thread waited  */
+    double bytes_read, bytes_written;
+} IoQueue;
+
+/* The helper thread makes no MPI calls, not even MPI_Wtime */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void do_io(IoReq *req) {
+    size_t left = req->bytes;
+    char *p = req->buf;
+    off_t off = req->offset;
+    while (left > 0) {
+        ssize_t r = req->write ? pwrite(req->fd, p, left, off) : pread(req->fd, p, left, off);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) {
+            req->error = r < 0 ? errno : EIO;
+            return;
+        }
+        left -= (size_t)r;
+        p += r;
+        off += r;
+    }
+}
+
+static void *io_thread(void *arg) {
+    IoQueue *q = arg;
+    pthread_mutex_lock(&q->lock);
+    for (;;) {
+        while (q->head == q->tail && !q->stop) pthread_cond_wait(&q->work, &q->lock);
+        if (q->head == q->tail) break;
+        IoReq *req = q->queue[q->head % QUEUE_SLOTS];
+        pthread_mutex_unlock(&q->lock);
+
+        double t0 = now();
+        do_io(req);
+        double t = now() - t0;
+
+        pthread_mutex_lock(&q->lock);
+        q->busy += t;
+        if (req->write) q->bytes_written += req->bytes;
+        else q->bytes_read += req->bytes;
+        req->done = 1;
+        q->head++;
+        pthread_cond_broadcast(&q->finished);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return NULL;
+}
+
+static void io_start(IoQueue *q) {
+    memset(q, 0, sizeof(*q));
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->work, NULL);
+    pthread_cond_init(&q->finished, NULL);
+    pthread_create(&q->thread, NULL, io_thread, q);
+}
+
+static void io_submit(IoQueue *q, IoReq *req, int fd, int write, void *buf, size_t bytes, off_t offset) {
+    req->fd = fd;
+    req->write = write;
+    req->buf = buf;
+    req->bytes = bytes;
+    req->offset = offset;
+    req->error = 0;
+    req->done = 0;
+    req->pending = 1;
+    pthread_mutex_lock(&q->lock);
+    while (q->tail - q->head == QUEUE_SLOTS) pthread_cond_wait(&q->finished, &q->lock);
+    q->queue[q->tail % QUEUE_SLOTS] = req;
+    q->tail++;
+    pthread_cond_signal(&q->work);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static void io_wait(IoQueue *q, IoReq *req, int rank) {
+    if (!req->pending) return;
+    double t0 = MPI_Wtime();
+    pthread_mutex_lock(&q->lock);
+    while (!req->done) pthread_cond_wait(&q->finished, &q->lock);
+    pthread_mutex_unlock(&q->lock);
+    q->stalled += MPI_Wtime() - t0;
+    req->pending = 0;
+    if (req->error) {
+        fprintf(stderr, "Rank %d: scratch file %s failed: %s\n", rank, req->write ? "write" : "read",
+                strerror(req->error));
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+}
+
+static void io_stop(IoQueue *q) {
+    pthread_mutex_lock(&q->lock);
+    q->stop = 1;
+    pthread_cond_signal(&q->work);
+    pthread_mutex_unlock(&q->lock);
+    pthread_join(q->thread, NULL);
+}
+
+/*------------------------------------------------------------*/
+
+/* Element (i, j) of a matrix identified by seed, in [MIN_VAL, MAX_VAL] */
+static int element(uint64_t seed, long i, long j) {
+    uint64_t z = seed * 0x9E3779B97F4A7C15ull + (uint64_t)i * 0xBF58476D1CE4E5B9ull + (uint64_t)j;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    return (int)(z % (MAX_VAL - MIN_VAL + 1)) + MIN_VAL;
+}
+
+static void fill_rows(int *buf, uint64_t seed, long first_row, int rows, int n) {
+    for (int i = 0; i < rows; ++i)
+        for (int j = 0; j < n; ++j) buf[(size_t)i * n + j] = element(seed, first_row + i, j);
+}
+
+static int open_scratch(const char *dir, const char *name, int rank, char *path, size_t len) {
+    snprintf(path, len, "%s/ooc_%s.%d", dir, name, rank);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        fprintf(stderr, "Rank %d: cannot create %s: %s\n", rank, path, strerror(errno));
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    return fd;
+}
+
+/* C band (rows x n) += A band columns [k0, k0 + depth) x B panel (depth x n) */
+static void multiply_panel(const int *A, const int *Bp, int *C, int rows, int n, int k0, int depth) {
+    for (int i = 0; i < rows; ++i) {
+        int *c = &C[(size_t)i * n];
+        for (int k = 0; k < depth; ++k) {
+            int a_ik = A[(size_t)i * n + k0 + k];
+            const int *b = &Bp[(size_t)k * n];
+            for (int j = 0; j < n; ++j) c[j] += a_ik * b[j];
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    /* The I/O thread makes no MPI calls, but the library must know there is one */
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    PR_INIT();
+
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    if (provided < MPI_THREAD_FUNNELED) {
+        if (rank == 0) fprintf(stderr, "Error: the MPI library does not support MPI_THREAD_FUNNELED.\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+
+    int n = argc > 1 ? atoi(argv[1]) : MATRIX_SIZE;
+    double budget_mb = argc > 2 ? atof(argv[2]) : DEFAULT_BUDGET_MB;
+    const char *dir = argc > 3 ? argv[3] : "/tmp";
+
+    if (n <= 0 || n % size != 0) {
+        if (rank == 0) fprintf(stderr, "Error: N (%d) must be divisible by number of processes (%d).\n", n, size);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    int rows_per_proc = n / size;
+
+    /* A quarter of the budget for the two B panels, the rest for two A and
+       two C bands */
+    size_t budget = (size_t)(budget_mb * 1024 * 1024);
+    size_t row_bytes = (size_t)n * sizeof(int);
+    int depth = (int)(budget / 4 / (2 * row_bytes));
+    if (depth > n) depth = n;
+    if (depth < 1) depth = 1;
+    size_t panel_bytes = 2 * (size_t)depth * row_bytes;
+    long band_rows = budget > panel_bytes ? (long)((budget - panel_bytes) / (4 * row_bytes)) : 0;
+    if (band_rows > rows_per_proc) band_rows = rows_per_proc;
+    if (band_rows < 1) {
+        if (rank == 0)
+            fprintf(stderr, "Error: a budget of %.1f MiB is too small for N=%d (need at least %.1f MiB).\n",
+                    budget_mb, n, 6.0 * row_bytes / (1024 * 1024));
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    int tr = (int)band_rows;
+    int nbands = (rows_per_proc + tr - 1) / tr;
+    int npanels = (n + depth - 1) / depth;
+
+    int *Abuf[2], *Bbuf[2], *Cbuf[2];
+    for (int s = 0; s < 2; ++s) {
+        Abuf[s] = malloc((size_t)tr * row_bytes);
+        Cbuf[s] = malloc((size_t)tr * row_bytes);
+        Bbuf[s] = malloc((size_t)depth * row_bytes);
+        if (!Abuf[s] || !Cbuf[s] || !Bbuf[s]) {
+            fprintf(stderr, "Rank %d: Memory allocation failure.\n", rank);
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+    }
+
+    char pathA[4096], pathB[4096], pathC[4096];
+    int fdA = open_scratch(dir, "A", rank, pathA, sizeof(pathA));
+    int fdB = open_scratch(dir, "B", rank, pathB, sizeof(pathB));
+    int fdC = open_scratch(dir, "C", rank, pathC, sizeof(pathC));
+
+    IoQueue io;
+    io_start(&io);
+    IoReq ra[2] = {{0}}, rb[2] = {{0}}, wc[2] = {{0}};
+
+    /* -------------------------------------------------------- */
+    /*        Set-up: write A rows and B to the scratch files   */
+    /* -------------------------------------------------------- */
+    double t_setup = MPI_Wtime();
+    long first_row = (long)rank * rows_per_proc;
+    for (int b = 0; b < nbands; ++b) {
+        int s = b & 1, rows = rows_per_proc - b * tr < tr ? rows_per_proc - b * tr : tr;
+        io_wait(&io, &ra[s], rank);
+        fill_rows(Abuf[s], 1, first_row + (long)b * tr, rows, n);
+        io_submit(&io, &ra[s], fdA, 1, Abuf[s], (size_t)rows * row_bytes, (off_t)b * tr * row_bytes);
+    }
+    for (int p = 0; p < npanels; ++p) {
+        int s = p & 1, rows = n - p * depth < depth ? n - p * depth : depth;
+        io_wait(&io, &rb[s], rank);
+        if (rank == 0) fill_rows(Bbuf[s], 2, (long)p * depth, rows, n);
+        PR_BEGIN(PR_COMM);
+        MPI_Bcast(Bbuf[s], rows * n, MPI_INT, 0, MPI_COMM_WORLD);
+        PR_END(PR_COMM);
+        io_submit(&io, &rb[s], fdB, 1, Bbuf[s], (size_t)rows * row_bytes, (off_t)p * depth * row_bytes);
+    }
+    for (int s = 0; s < 2; ++s) {
+        io_wait(&io, &ra[s], rank);
+        io_wait(&io, &rb[s], rank);
+    }
+    t_setup = MPI_Wtime() - t_setup;
+
+    /* -------------------------------------------------------- */
+    /*        Out-of-core multiplication                        */
+    /* -------------------------------------------------------- */
+    MPI_Barrier(MPI_COMM_WORLD);
+    io.busy = io.stalled = io.bytes_read = io.bytes_written = 0.0;
+    double t0 = MPI_Wtime();
+    double t_compute = 0.0;
+    long long checksum = 0;
+
+    int sa = 0, sb = 0, sc = 0;
+    io_submit(&io, &ra[0], fdA, 0, Abuf[0], (size_t)(rows_per_proc < tr ? rows_per_proc : tr) * row_bytes, 0);
+    io_submit(&io, &rb[0], fdB, 0, Bbuf[0], (size_t)(n < depth ? n : depth) * row_bytes, 0);
+
+    for (int b = 0; b < nbands; ++b) {
+        int rows = rows_per_proc - b * tr < tr ? rows_per_proc - b * tr : tr;
+        io_wait(&io, &ra[sa], rank);
+        if (b + 1 < nbands) {
+            int next = rows_per_proc - (b + 1) * tr < tr ? rows_per_proc - (b + 1) * tr : tr;
+            io_submit(&io, &ra[sa ^ 1], fdA, 0, Abuf[sa ^ 1], (size_t)next * row_bytes,
+                      (off_t)(b + 1) * tr * row_bytes);
+        }
+        /* The C buffer is free again once its previous band is on disk */
+        io_wait(&io, &wc[sc], rank);
+        memset(Cbuf[sc], 0, (size_t)rows * row_bytes);
+
+        for (int p = 0; p < npanels; ++p) {
+            int k0 = p * depth, kd = n - k0 < depth ? n - k0 : depth;
+            io_wait(&io, &rb[sb], rank);
+            /* Read ahead the next panel, which wraps to the first one for the
+               next band */
+            if (p + 1 < npanels || b + 1 < nbands) {
+                int nk0 = p + 1 < npanels ? k0 + depth : 0;
+                int nkd = n - nk0 < depth ? n - nk0 : depth;
+                io_submit(&io, &rb[sb ^ 1], fdB, 0, Bbuf[sb ^ 1], (size_t)nkd * row_bytes, (off_t)nk0 * row_bytes);
+            }
+            double tc = MPI_Wtime();
+            PR_BEGIN(PR_COMPUTE);
+            multiply_panel(Abuf[sa], Bbuf[sb], Cbuf[sc], rows, n, k0, kd);
+            PR_END(PR_COMPUTE);
+            PR_OPS(PR_COMPUTE, 2.0 * rows * kd * n);
+            t_compute += MPI_Wtime() - tc;
+            sb ^= 1;
+        }
+
+        for (size_t e = 0; e < (size_t)rows * n; ++e) checksum += Cbuf[sc][e];
+        io_submit(&io, &wc[sc], fdC, 1, Cbuf[sc], (size_t)rows * row_bytes, (off_t)b * tr * row_bytes);
+        sc ^= 1;
+        sa ^= 1;
+    }
+    for (int s = 0; s < 2; ++s) io_wait(&io, &wc[s], rank);
+
+    double local_elapsed = MPI_Wtime() - t0;
+
+    /* -------------------------------------------------------- */
+    /*        End of multiplication phase                       */
+    /* -------------------------------------------------------- */
+
+    double local[5] = {local_elapsed, t_compute, io.stalled, io.busy, t_setup}, max[5];
+    double moved[2] = {io.bytes_read, io.bytes_written}, total[2];
+    long long sum;
+    MPI_Reduce(local, max, 5, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(moved, total, 2, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&checksum, &sum, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        double tiles = (4.0 * tr + 2.0 * depth) * row_bytes / (1024 * 1024);
+        printf("Out-of-core matrix multiplication %dx%d completed in %.6f seconds across %d process(es).\n", n, n,
+               max[0], size);
+        printf("  tiles: %d-row bands x %d-row panels, %.1f MiB per rank (budget %.1f MiB)\n", tr, depth, tiles,
+               budget_mb);
+        printf("  compute %.6f s, stalled on I/O %.6f s, I/O busy %.6f s (max per rank); set-up %.6f s\n", max[1],
+               max[2], max[3], max[4]);
+        printf("  read %.1f MiB, written %.1f MiB (all ranks)\n", total[0] / (1024 * 1024), total[1] / (1024 * 1024));
+        printf("  checksum of C: %lld\n", sum);
+    }
+
+    PR_REPORT(MPI_COMM_WORLD, "block rows out-of-core");
+
+    io_stop(&io);
+    close(fdA);
+    close(fdB);
+    close(fdC);
+    unlink(pathA);
+    unlink(pathB);
+    for (int s = 0; s < 2; ++s) {
+        free(Abuf[s]);
+        free(Bbuf[s]);
+        free(Cbuf[s]);
+    }
+    MPI_Finalize();
+    return 0;
+}
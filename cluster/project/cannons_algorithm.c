@@ -1,10 +1,16 @@
 // cannon_multiply_parallel.c
+// Block shifts go through compressed_transport.c: CT_MODE=on|auto packs the
+// blocks before sending, and the next blocks travel during the local multiply
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
 
+#include "perf_regions.h"
+#include "compressed_transport.h"
+#include "matrix_alloc.h"
+
 #define MATRIX_SIZE 1024
 #define MAX_VAL 10
 #define MIN_VAL 1
@@ -21,14 +27,22 @@ void local_multiply(int *A, int *B, int *C, int block) {
                 C[i * block + j] += A[i * block + k] * B[k * block + j];
 }
 
-void shift_matrix(int *mat, int block, int count, int direction, MPI_Comm comm2d) {
+// Starts shifting mat one step along direction; the block travels through the
+// link (compressed when CT_MODE says so) while the caller keeps using mat
+void shift_begin(CtLink *link, const int *mat, int block, int direction, MPI_Comm comm2d) {
     int src, dst;
     MPI_Cart_shift(comm2d, direction, 1, &src, &dst);
-    MPI_Sendrecv_replace(mat, block * block, MPI_INT, dst, 0, src, 0, comm2d, MPI_STATUS_IGNORE);
+    ct_shift_begin(link, mat, block * block, dst, src);
+}
+
+void shift_matrix(CtLink *link, int *mat, int block, int direction, MPI_Comm comm2d) {
+    shift_begin(link, mat, block, direction, comm2d);
+    ct_shift_end(link, mat);
 }
 
 int main(int argc, char *argv[]) {
     MPI_Init(&argc, &argv);
+    PR_INIT();
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
@@ -47,22 +61,27 @@ int main(int argc, char *argv[]) {
     int n = MATRIX_SIZE;
     int block = n / q;
 
-    int *Ablock = malloc(block * block * sizeof(int));
-    int *Bblock = malloc(block * block * sizeof(int));
-    int *Cblock = calloc(block * block, sizeof(int));
+    int *Ablock = matrix_alloc(block * block * sizeof(int));
+    int *Bblock = matrix_alloc(block * block * sizeof(int));
+    int *Cblock = matrix_alloc(block * block * sizeof(int));
+
+    CtLink linkA, linkB;
+    ct_link_init(&linkA, "A", comm2d);
+    ct_link_init(&linkB, "B", comm2d);
 
     int *A = NULL, *B = NULL;
     if (rank == 0) {
-        A = malloc(n * n * sizeof(int));
-        B = malloc(n * n * sizeof(int));
+        A = matrix_alloc(n * n * sizeof(int));
+        B = matrix_alloc(n * n * sizeof(int));
         fill_random(A, n * n);
         fill_random(B, n * n);
     }
 
     int *Ascat = NULL, *Bscat = NULL;
     if (rank == 0) {
-        Ascat = malloc(size * block * block * sizeof(int));
-        Bscat = malloc(size * block * block * sizeof(int));
+        PR_BEGIN(PR_COPY);
+        Ascat = matrix_alloc(size * block * block * sizeof(int));
+        Bscat = matrix_alloc(size * block * block * sizeof(int));
         for (int proc = 0; proc < size; ++proc) {
             int i = proc / q, j = proc % q;
             for (int bi = 0; bi < block; ++bi)
@@ -74,29 +93,48 @@ int main(int argc, char *argv[]) {
                        &B[(i * block + bi) * n + j * block],
                        block * sizeof(int));
         }
+        PR_END(PR_COPY);
     }
 
+    PR_BEGIN(PR_COMM);
     MPI_Scatter(Ascat, block * block, MPI_INT, Ablock, block * block, MPI_INT, 0, MPI_COMM_WORLD);
     MPI_Scatter(Bscat, block * block, MPI_INT, Bblock, block * block, MPI_INT, 0, MPI_COMM_WORLD);
-    if (rank == 0) { free(Ascat); free(Bscat); }
+    if (rank == 0) { matrix_free(Ascat); matrix_free(Bscat); }
 
-    for (int i = 0; i < coords[0]; ++i) shift_matrix(Ablock, block, q, 1, comm2d);
-    for (int i = 0; i < coords[1]; ++i) shift_matrix(Bblock, block, q, 0, comm2d);
+    for (int i = 0; i < coords[0]; ++i) shift_matrix(&linkA, Ablock, block, 1, comm2d);
+    for (int i = 0; i < coords[1]; ++i) shift_matrix(&linkB, Bblock, block, 0, comm2d);
+    PR_END(PR_COMM);
 
     MPI_Barrier(MPI_COMM_WORLD);
     double t0 = MPI_Wtime();
 
+    // The next blocks are in flight while the current ones are multiplied
     for (int step = 0; step < q; ++step) {
+        PR_BEGIN(PR_COMM);
+        shift_begin(&linkA, Ablock, block, 1, comm2d);
+        shift_begin(&linkB, Bblock, block, 0, comm2d);
+        PR_END(PR_COMM);
+        PR_BEGIN(PR_COMPUTE);
         local_multiply(Ablock, Bblock, Cblock, block);
-        shift_matrix(Ablock, block, q, 1, comm2d);
-        shift_matrix(Bblock, block, q, 0, comm2d);
+        PR_END(PR_COMPUTE);
+        PR_OPS(PR_COMPUTE, 2.0 * block * block * block);
+        PR_BEGIN(PR_COMM);
+        ct_shift_end(&linkA, Ablock);
+        ct_shift_end(&linkB, Bblock);
+        PR_END(PR_COMM);
     }
 
     double elapsed = MPI_Wtime() - t0;
     if (rank == 0) printf("Cannon completado en %.6f segundos\n", elapsed);
 
-    free(Ablock); free(Bblock); free(Cblock);
-    if (rank == 0) { free(A); free(B); }
+    ct_link_report(&linkA);
+    ct_link_report(&linkB);
+    PR_REPORT(MPI_COMM_WORLD, "Cannon");
+    matrix_alloc_report(MPI_COMM_WORLD, "Cannon");
+
+    matrix_free(Ablock); matrix_free(Bblock); matrix_free(Cblock);
+    ct_link_free(&linkA); ct_link_free(&linkB);
+    if (rank == 0) { matrix_free(A); matrix_free(B); }
     MPI_Comm_free(&comm2d);
     MPI_Finalize();
     return 0;
@@ -0,0 +1,307 @@
+/*
+ * Compressed transport for the bulk block transfers, see compressed_transport.h
+ *
+ * Wire format (32-bit words):
+ *     [0] encoding (RAW, PACKED or DELTA)   [1] element count
+ *     [2] reference (minimum)               [3] bits per element
+ *     [4] first value (DELTA only)          [5...] payload
+ */
+
+#include "compressed_transport.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { ENC_RAW, ENC_PACKED, ENC_DELTA };
+
+#define HEADER_WORDS 5
+#define PROBE_BYTES (1 << 20)
+#define REPROBE_EVERY 8             /* raw transfers before auto mode retries */
+
+/*------------------------------------------------------------*/
+/* Codec                                                      */
+/*------------------------------------------------------------*/
+
+static int bit_width(uint64_t range) {
+    int bits = 0;
+    while (range >> bits) ++bits;
+    return bits;
+}
+
+static uint32_t zigzag(int32_t d) {
+    return ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+}
+
+static int32_t unzigzag(uint32_t z) {
+    return (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+}
+
+static size_t pack(const uint32_t *src, int count, int bits, uint32_t ref, uint32_t *out) {
+    uint64_t acc = 0;
+    int filled = 0;
+    size_t words = 0;
+    for (int i = 0; i < count; ++i) {
+        acc |= (uint64_t)(src[i] - ref) << filled;
+        filled += bits;
+        if (filled >= 32) {
+            out[words++] = (uint32_t)acc;
+            acc >>= 32;
+            filled -= 32;
+        }
+    }
+    if (filled > 0) out[words++] = (uint32_t)acc;
+    return words;
+}
+
+/* Encode count ints into out (room for HEADER_WORDS + count words); returns words */
+static size_t encode(const int *v, int count, int compress, uint32_t *out) {
+    out[0] = ENC_RAW;
+    out[1] = (uint32_t)count;
+    out[2] = out[3] = out[4] = 0;
+    if (!compress || count < 2) {
+        memcpy(out + HEADER_WORDS, v, (size_t)count * sizeof(int));
+        return HEADER_WORDS + (size_t)count;
+    }
+
+    int32_t vmin = v[0], vmax = v[0];
+    uint32_t zmin = UINT32_MAX, zmax = 0;
+    for (int i = 1; i < count; ++i) {
+        if (v[i] < vmin) vmin = v[i];
+        if (v[i] > vmax) vmax = v[i];
+        uint32_t z = zigzag((int32_t)((uint32_t)v[i] - (uint32_t)v[i - 1]));
+        if (z < zmin) zmin = z;
+        if (z > zmax) zmax = z;
+    }
+    int bits_v = bit_width((uint64_t)((int64_t)vmax - vmin));
+    int bits_d = bit_width((uint64_t)zmax - zmin);
+    if ((bits_v < bits_d ? bits_v : bits_d) > 28) return encode(v, count, 0, out);
+
+    size_t words;
+    if (bits_v <= bits_d) {
+        out[0] = ENC_PACKED;
+        out[2] = (uint32_t)vmin;
+        out[3] = (uint32_t)bits_v;
+        words = bits_v ? pack((const uint32_t *)v, count, bits_v, (uint32_t)vmin, out + HEADER_WORDS) : 0;
+    } else {
+        /* Deltas are zigzagged in place in the payload area, then packed */
+        uint32_t *z = out + HEADER_WORDS;
+        for (int i = 1; i < count; ++i) z[i - 1] = zigzag((int32_t)((uint32_t)v[i] - (uint32_t)v[i - 1]));
+        out[0] = ENC_DELTA;
+        out[2] = zmin;
+        out[3] = (uint32_t)bits_d;
+        out[4] = (uint32_t)v[0];
+        words = bits_d ? pack(z, count - 1, bits_d, zmin, z) : 0;
+    }
+    return HEADER_WORDS + words;
+}
+
+static void decode(const uint32_t *in, int *v) {
+    int count = (int)in[1], bits = (int)in[3];
+    const uint32_t *payload = in + HEADER_WORDS;
+    if (in[0] == ENC_RAW) {
+        memcpy(v, payload, (size_t)count * sizeof(int));
+        return;
+    }
+    uint64_t mask = bits ? ((uint64_t)1 << bits) - 1 : 0, acc = 0;
+    int filled = 0;
+    size_t word = 0;
+    int first = in[0] == ENC_DELTA;
+    if (first) v[0] = (int)in[4];
+    for (int i = first; i < count; ++i) {
+        if (filled < bits) {
+            acc |= (uint64_t)payload[word++] << filled;
+            filled += 32;
+        }
+        uint32_t value = (uint32_t)(acc & mask) + in[2];
+        acc >>= bits;
+        filled -= bits;
+        v[i] = first ? (int)((uint32_t)v[i - 1] + (uint32_t)unzigzag(value)) : (int)value;
+    }
+}
+
+/*------------------------------------------------------------*/
+/* Links                                                      */
+/*------------------------------------------------------------*/
+
+/* Grow one side's buffer to a framed block of count ints. Each side is
+   allocated only by the calls that use it: a block-sized buffer is a large
+   share of a container's memory. */
+static void ensure_buffer(const CtLink *link, uint32_t **buf, size_t *words, int count) {
+    size_t need = HEADER_WORDS + (size_t)count;
+    if (need <= *words) return;
+    free(*buf);
+    *buf = malloc(need * sizeof(uint32_t));
+    if (!*buf) {
+        fprintf(stderr, "Rank %d: Memory allocation failure.\n", link->rank);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    *words = need;
+}
+
+/* Slowest ring exchange across the communicator, in bytes/s */
+static double probe_link(MPI_Comm comm, int rank, int size) {
+    if (size == 1) return 0.0;
+    char *out = calloc(PROBE_BYTES, 1), *in = malloc(PROBE_BYTES);
+    double best = 1e30;
+    for (int rep = 0; rep < 3; ++rep) {
+        MPI_Barrier(comm);
+        double t0 = MPI_Wtime();
+        MPI_Sendrecv(out, PROBE_BYTES, MPI_BYTE, (rank + 1) % size, 0, in, PROBE_BYTES, MPI_BYTE,
+                     (rank + size - 1) % size, 0, comm, MPI_STATUS_IGNORE);
+        double t = MPI_Wtime() - t0;
+        if (t < best) best = t;
+    }
+    free(out);
+    free(in);
+    double bps = PROBE_BYTES / best;
+    MPI_Allreduce(MPI_IN_PLACE, &bps, 1, MPI_DOUBLE, MPI_MIN, comm);
+    return bps;
+}
+
+void ct_link_init(CtLink *link, const char *name, MPI_Comm comm) {
+    int size;
+    memset(link, 0, sizeof(*link));
+    link->name = name;
+    link->comm = comm;
+    link->ratio = 1.0;
+    MPI_Comm_rank(comm, &link->rank);
+    MPI_Comm_size(comm, &size);
+
+    const char *mode = getenv("CT_MODE");
+    link->mode = !mode || strcmp(mode, "off") == 0 ? CT_OFF : strcmp(mode, "auto") == 0 ? CT_AUTO : CT_ON;
+    link->verbose = getenv("CT_VERBOSE") && atoi(getenv("CT_VERBOSE"));
+    if (getenv("CT_LINK_MBS")) link->link_bps = atof(getenv("CT_LINK_MBS")) * 1e6;
+    else if (link->mode != CT_OFF) link->link_bps = probe_link(comm, link->rank, size);
+}
+
+/* Compress only if coding both ways plus the smaller message is predicted
+   to be faster than the raw message. The prediction uses the last ratio, so
+   after REPROBE_EVERY raw transfers one is compressed again in case the
+   data has become more compressible. */
+static int should_compress(CtLink *link, double raw) {
+    if (link->mode != CT_AUTO) return link->mode == CT_ON;
+    if (link->link_bps <= 0.0) return 0;
+    if (link->codec_bps <= 0.0) return 1;   /* nothing measured yet: try once */
+    double t_raw = raw / link->link_bps;
+    double t_comp = 2.0 * raw / link->codec_bps + raw * link->ratio / link->link_bps;
+    if (t_comp < t_raw || ++link->raw_run >= REPROBE_EVERY) {
+        link->raw_run = 0;
+        return 1;
+    }
+    return 0;
+}
+
+/* Account one transfer; codec time covers encoding and, later, decoding */
+static void account(CtLink *link, int compressed, double raw, double wire, double codec_time) {
+    link->transfers++;
+    link->compressed += compressed;
+    link->raw_bytes += raw;
+    link->wire_bytes += wire;
+    link->codec_seconds += codec_time;
+    double saved = 0.0;
+    if (compressed && link->link_bps > 0.0) saved = (raw - wire) / link->link_bps - codec_time;
+    link->saved_seconds += saved;
+    if (compressed) {
+        link->ratio = wire / raw;
+        if (codec_time > 0.0)
+            link->codec_bps = link->codec_bps > 0.0 ? 0.5 * (link->codec_bps + raw / codec_time) : raw / codec_time;
+    }
+    if (link->verbose && link->rank == 0) {
+        printf("ct[%s] #%ld: %.0f -> %.0f bytes (ratio %.3f), codec %.3f ms", link->name, link->transfers, raw,
+               wire, wire / raw, 1e3 * codec_time);
+        if (link->link_bps > 0.0) printf(", est. saved %.3f ms", 1e3 * saved);
+        printf("\n");
+    }
+}
+
+void ct_shift_begin(CtLink *link, const int *block, int count, int dst, int src) {
+    ensure_buffer(link, &link->recv_buf, &link->recv_words, count);
+    if (link->mode == CT_OFF) {
+        /* Plain transfer straight from the caller's block */
+        link->sent_words = (size_t)count;
+        MPI_Irecv(link->recv_buf, count, MPI_INT, src, 0, link->comm, &link->reqs[0]);
+        MPI_Isend(block, count, MPI_INT, dst, 0, link->comm, &link->reqs[1]);
+        return;
+    }
+    ensure_buffer(link, &link->send_buf, &link->send_words, count);
+    int compress = should_compress(link, (double)count * sizeof(int));
+
+    double t0 = MPI_Wtime();
+    link->sent_words = encode(block, count, compress, link->send_buf);
+    link->codec_time = compress ? MPI_Wtime() - t0 : 0.0;
+    link->sent_compressed = link->send_buf[0] != ENC_RAW;
+
+    MPI_Irecv(link->recv_buf, (int)link->recv_words, MPI_UINT32_T, src, 0, link->comm, &link->reqs[0]);
+    MPI_Isend(link->send_buf, (int)link->sent_words, MPI_UINT32_T, dst, 0, link->comm, &link->reqs[1]);
+}
+
+void ct_shift_end(CtLink *link, int *block) {
+    MPI_Waitall(2, link->reqs, MPI_STATUSES_IGNORE);
+    if (link->mode == CT_OFF) {
+        memcpy(block, link->recv_buf, link->sent_words * sizeof(int));
+        return;
+    }
+    double t0 = MPI_Wtime();
+    decode(link->recv_buf, block);
+    if (link->recv_buf[0] != ENC_RAW) link->codec_time += MPI_Wtime() - t0;
+    account(link, link->sent_compressed, (double)link->send_buf[1] * sizeof(int),
+            (double)link->sent_words * sizeof(uint32_t), link->codec_time);
+}
+
+void ct_bcast(CtLink *link, int *buf, int count, int root) {
+    if (link->mode == CT_OFF) {
+        MPI_Bcast(buf, count, MPI_INT, root, link->comm);
+        return;
+    }
+    /* The root only sends, the others only receive */
+    if (link->rank == root) ensure_buffer(link, &link->send_buf, &link->send_words, count);
+    else ensure_buffer(link, &link->recv_buf, &link->recv_words, count);
+    double codec_time = 0.0;
+    int words = 0;
+    if (link->rank == root) {
+        int compress = should_compress(link, (double)count * sizeof(int));
+        double t0 = MPI_Wtime();
+        words = (int)encode(buf, count, compress, link->send_buf);
+        if (compress) codec_time = MPI_Wtime() - t0;
+    }
+    MPI_Bcast(&words, 1, MPI_INT, root, link->comm);
+    uint32_t *wire = link->rank == root ? link->send_buf : link->recv_buf;
+    MPI_Bcast(wire, words, MPI_UINT32_T, root, link->comm);
+
+    int compressed = wire[0] != ENC_RAW;
+    double decode_time = 0.0;
+    if (link->rank != root) {
+        double t0 = MPI_Wtime();
+        decode(wire, buf);
+        if (compressed) decode_time = MPI_Wtime() - t0;
+    }
+    /* The root alone decides, so the root alone keeps the statistics, with
+       the slowest receiver's decode */
+    double slowest = 0.0;
+    MPI_Reduce(&decode_time, &slowest, 1, MPI_DOUBLE, MPI_MAX, root, link->comm);
+    if (link->rank == root)
+        account(link, compressed, (double)count * sizeof(int), (double)words * sizeof(uint32_t), codec_time + slowest);
+}
+
+/* Totals over all ranks, printed by rank 0 */
+void ct_link_report(CtLink *link) {
+    double local[6] = {(double)link->transfers, (double)link->compressed, link->raw_bytes, link->wire_bytes,
+                       link->codec_seconds, link->saved_seconds};
+    double sum[6];
+    MPI_Reduce(local, sum, 6, MPI_DOUBLE, MPI_SUM, 0, link->comm);
+    if (link->rank != 0 || link->mode == CT_OFF || sum[0] == 0) return;
+    printf("Compressed transport [%s]: %.0f transfer(s), %.0f compressed, %.0f -> %.0f bytes (ratio %.3f), "
+           "codec %.6f s",
+           link->name, sum[0], sum[1], sum[2], sum[3], sum[2] > 0 ? sum[3] / sum[2] : 1.0, sum[4]);
+    /* Without a link bandwidth (single rank) there is no estimate */
+    if (link->link_bps > 0.0) printf(", est. saved %.6f s", sum[5]);
+    printf("\n");
+}
+
+void ct_link_free(CtLink *link) {
+    free(link->send_buf);
+    free(link->recv_buf);
+    link->send_buf = link->recv_buf = NULL;
+    link->send_words = link->recv_words = 0;
+}
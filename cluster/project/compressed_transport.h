@@ -0,0 +1,64 @@
+/*
+ * Compressed transport for the bulk block transfers of the drivers
+ * -----------------------------------------------------------------
+ *  - Purpose: Ship fewer bytes over the Docker overlay network, whose
+ *    bandwidth is far below memory bandwidth, when the blocks' values fit
+ *    in a few bits (the drivers fill A and B with integers in [1,10]).
+ *  - Features:
+ *      • Frame-of-reference bit-packing of int blocks, on the values or on
+ *        their zigzag deltas, whichever needs fewer bits
+ *      • Neighbour shift split in begin/end so that the transfer runs while
+ *        the caller computes on the current block
+ *      • Broadcast with the root choosing the encoding
+ *      • Adaptive on/off: a transfer is compressed only if the measured
+ *        codec throughput and the last compression ratio predict that
+ *        coding + sending fewer bytes beats sending the raw block over the
+ *        measured link bandwidth; after a few transfers sent raw, one is
+ *        compressed again to refresh the ratio
+ *      • Per-transfer compression ratio and estimated time saved
+ *      • With CT_MODE=off the transfers are plain MPI_Isend/Irecv and
+ *        MPI_Bcast of the ints, with no framing or extra collectives
+ *
+ *  Environment
+ *  -----------
+ *      CT_MODE      off (default), on, or auto
+ *      CT_LINK_MBS  link bandwidth in MB/s; probed at init (on and auto) when unset
+ *      CT_VERBOSE   1 prints one line per transfer on rank 0
+ */
+
+#ifndef COMPRESSED_TRANSPORT_H
+#define COMPRESSED_TRANSPORT_H
+
+#include <mpi.h>
+#include <stdint.h>
+
+enum { CT_OFF, CT_ON, CT_AUTO };
+
+typedef struct {
+    const char *name;
+    MPI_Comm comm;
+    int rank, mode, verbose;
+    double link_bps;          /* measured or given link bandwidth     */
+    double codec_bps;         /* running estimate, bytes/s per side   */
+    double ratio;             /* last wire / raw bytes                */
+    int raw_run;              /* transfers sent raw since last try    */
+    /* in-flight shift */
+    uint32_t *send_buf, *recv_buf;  /* allocated on first use        */
+    size_t send_words, recv_words;  /* their capacities              */
+    MPI_Request reqs[2];
+    size_t sent_words;
+    int sent_compressed;
+    double codec_time;
+    /* totals */
+    long transfers, compressed;
+    double raw_bytes, wire_bytes, codec_seconds, saved_seconds;
+} CtLink;
+
+void ct_link_init(CtLink *link, const char *name, MPI_Comm comm);
+void ct_shift_begin(CtLink *link, const int *block, int count, int dst, int src);
+void ct_shift_end(CtLink *link, int *block);
+void ct_bcast(CtLink *link, int *buf, int count, int root);
+void ct_link_report(CtLink *link);
+void ct_link_free(CtLink *link);
+
+#endif
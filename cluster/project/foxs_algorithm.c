@@ -5,6 +5,9 @@
 #include <math.h>
 #include <string.h>
 
+#include "perf_regions.h"
+#include "matrix_alloc.h"
+
 #define MATRIX_SIZE 1024
 #define MAX_VAL 10
 #define MIN_VAL 1
@@ -29,6 +32,7 @@ void shift_matrix(int *mat, int block, int count, int direction, MPI_Comm comm2d
 
 int main(int argc, char *argv[]) {
     MPI_Init(&argc, &argv);
+    PR_INIT();
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
@@ -47,22 +51,23 @@ int main(int argc, char *argv[]) {
     int n = MATRIX_SIZE;
     int block = n / q;
 
-    int *Ablock = malloc(block * block * sizeof(int));
-    int *Bblock = malloc(block * block * sizeof(int));
-    int *Cblock = calloc(block * block, sizeof(int));
+    int *Ablock = matrix_alloc(block * block * sizeof(int));
+    int *Bblock = matrix_alloc(block * block * sizeof(int));
+    int *Cblock = matrix_alloc(block * block * sizeof(int));
 
     int *A = NULL, *B = NULL;
     if (rank == 0) {
-        A = malloc(n * n * sizeof(int));
-        B = malloc(n * n * sizeof(int));
+        A = matrix_alloc(n * n * sizeof(int));
+        B = matrix_alloc(n * n * sizeof(int));
         fill_random(A, n * n);
         fill_random(B, n * n);
     }
 
     int *Ascat = NULL, *Bscat = NULL;
     if (rank == 0) {
-        Ascat = malloc(size * block * block * sizeof(int));
-        Bscat = malloc(size * block * block * sizeof(int));
+        PR_BEGIN(PR_COPY);
+        Ascat = matrix_alloc(size * block * block * sizeof(int));
+        Bscat = matrix_alloc(size * block * block * sizeof(int));
         for (int proc = 0; proc < size; ++proc) {
             int i = proc / q, j = proc % q;
             for (int bi = 0; bi < block; ++bi)
@@ -74,29 +79,40 @@ int main(int argc, char *argv[]) {
                        &B[(i * block + bi) * n + j * block],
                        block * sizeof(int));
         }
+        PR_END(PR_COPY);
     }
 
+    PR_BEGIN(PR_COMM);
     MPI_Scatter(Ascat, block * block, MPI_INT, Ablock, block * block, MPI_INT, 0, MPI_COMM_WORLD);
     MPI_Scatter(Bscat, block * block, MPI_INT, Bblock, block * block, MPI_INT, 0, MPI_COMM_WORLD);
-    if (rank == 0) { free(Ascat); free(Bscat); }
+    if (rank == 0) { matrix_free(Ascat); matrix_free(Bscat); }
 
     for (int i = 0; i < coords[0]; ++i) shift_matrix(Ablock, block, q, 1, comm2d);
     for (int i = 0; i < coords[1]; ++i) shift_matrix(Bblock, block, q, 0, comm2d);
+    PR_END(PR_COMM);
 
     MPI_Barrier(MPI_COMM_WORLD);
     double t0 = MPI_Wtime();
 
     for (int step = 0; step < q; ++step) {
+        PR_BEGIN(PR_COMPUTE);
         local_multiply(Ablock, Bblock, Cblock, block);
+        PR_END(PR_COMPUTE);
+        PR_OPS(PR_COMPUTE, 2.0 * block * block * block);
+        PR_BEGIN(PR_COMM);
         shift_matrix(Ablock, block, q, 1, comm2d);
         shift_matrix(Bblock, block, q, 0, comm2d);
+        PR_END(PR_COMM);
     }
 
     double elapsed = MPI_Wtime() - t0;
     if (rank == 0) printf("Fox completado en %.6f segundos\n", elapsed);
 
-    free(Ablock); free(Bblock); free(Cblock);
-    if (rank == 0) { free(A); free(B); }
+    PR_REPORT(MPI_COMM_WORLD, "Fox");
+    matrix_alloc_report(MPI_COMM_WORLD, "Fox");
+
+    matrix_free(Ablock); matrix_free(Bblock); matrix_free(Cblock);
+    if (rank == 0) { matrix_free(A); matrix_free(B); }
     MPI_Comm_free(&comm2d);
     MPI_Finalize();
     return 0;
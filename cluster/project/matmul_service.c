@@ -0,0 +1,498 @@
+/*
+ * Persistent matrix multiplication service using MPI (MPICH)
+ * -----------------------------------------------------------
+ *  - Purpose: Serve a stream of multiplication jobs without paying, for
+ *    every job, the mpirun launch, MPI_Init, MPI_Cart_create, allocation
+ *    and operand distribution that the one-shot drivers pay.
+ *  - Features:
+ *      • Ranks stay resident with their q x q Cartesian communicator,
+ *        block buffers and an operand cache between jobs
+ *      • Jobs are descriptor files dropped in <spool>/incoming on the
+ *        master container; rank 0 waits on them with inotify, runs them
+ *        in name order and moves each to <spool>/done or <spool>/failed
+ *        with its status appended
+ *      • Cannon's algorithm on the grid; operands are scattered already
+ *        skewed, so there is no initial alignment shift
+ *      • Distributed operands are cached per rank under their spec (and
+ *        role), so a matrix reused across jobs, like a fixed B, is not
+ *        re-read nor re-sent
+ *      • Idle ranks wait in a non-blocking broadcast with short sleeps
+ *        instead of spinning in MPI_Bcast
+ *
+ *  Build & run examples
+ *  --------------------
+ *      mpicc -O3 -o matmul_service matmul_service.c
+ *      mpirun -np 16 ./matmul_service                 # spool in ./spool
+ *      mpirun -np 16 ./matmul_service /project/spool
+ *
+ *  Job descriptor (key=value lines)
+ *  --------------------------------
+ *      n=1024                    matrix order, divisible by sqrt(P)
+ *      a=random:42               operand spec: random:<seed> or
+ *      b=file:/project/B.bin       file:<path> (raw int32, row-major)
+ *      out=/project/C.bin        optional, raw int32 row-major result
+ *
+ *      op=shutdown               stops the service
+ *
+ *  Write the descriptor elsewhere and rename(2) it into incoming/ so that
+ *  the service never reads a half written file.
+ *
+ *  Notes
+ *  -----
+ *      • A file operand is cached together with its modification time, so
+ *        rewriting the file invalidates the cached copy.
+ *      • After the q shifts of Cannon's algorithm every block is back on
+ *        its owner, so the cached operands are shifted in place and are
+ *        intact at the end of each job.
+ */
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#define MAX_VAL 10
+#define MIN_VAL 1
+#ifndef CACHE_SLOTS
+#define CACHE_SLOTS 4
+#endif
+#define SPEC_LEN 256
+#define KEY_LEN (SPEC_LEN + 32)
+
+enum { OP_MULTIPLY = 0, OP_SHUTDOWN = 1 };
+
+/* Job as broadcast to every rank */
+typedef struct {
+    int op;
+    int n;
+    char a_key[KEY_LEN];   /* spec of A plus file mtime, cache key */
+    char b_key[KEY_LEN];
+} Job;
+
+typedef struct {
+    char key[KEY_LEN + 2]; /* role prefix + Job key */
+    int n;
+    int *block;
+    unsigned long last_use;
+} CacheEntry;
+
+typedef struct {
+    MPI_Comm comm2d;
+    int rank, size, q, coords[2];
+    CacheEntry cache[CACHE_SLOTS];
+    unsigned long clock;
+    int *Cblock;           /* result block, grown on demand         */
+    size_t Cblock_elems;
+    int *full, *packed;    /* rank 0 only: full matrix and blocks   */
+    size_t full_elems, packed_elems;
+} Service;
+
+/*------------------------------------------------------------*/
+static void fill_random(int *mat, size_t elements, unsigned seed) {
+    for (size_t i = 0; i < elements; ++i)
+        mat[i] = rand_r(&seed) % (MAX_VAL - MIN_VAL + 1) + MIN_VAL;
+}
+
+static void local_multiply(int *A, int *B, int *C, int block) {
+    for (int i = 0; i < block; ++i)
+        for (int k = 0; k < block; ++k)
+            for (int j = 0; j < block; ++j)
+                C[i * block + j] += A[i * block + k] * B[k * block + j];
+}
+
+static void shift_matrix(int *mat, int block, int direction, MPI_Comm comm2d) {
+    int src, dst;
+    MPI_Cart_shift(comm2d, direction, 1, &src, &dst);
+    MPI_Sendrecv_replace(mat, block * block, MPI_INT, dst, 0, src, 0, comm2d, MPI_STATUS_IGNORE);
+}
+
+static void *grow(void *buf, size_t *have, size_t need) {
+    if (need <= *have) return buf;
+    free(buf);
+    buf = malloc(need * sizeof(int));
+    *have = buf ? need : 0;
+    return buf;
+}
+
+/*------------------------------------------------------------*/
+/* Rank 0: descriptor parsing and spool handling              */
+/*------------------------------------------------------------*/
+
+/* Turn an operand spec into its cache key; -1 if the spec is invalid */
+static int operand_key(const char *spec, char *key) {
+    if (strncmp(spec, "random:", 7) == 0) {
+        snprintf(key, KEY_LEN, "%s", spec);
+        return 0;
+    }
+    if (strncmp(spec, "file:", 5) == 0) {
+        struct stat st;
+        if (stat(spec + 5, &st) != 0) return -1;
+        snprintf(key, KEY_LEN, "%s@%ld.%09ld", spec, (long)st.st_mtim.tv_sec, (long)st.st_mtim.tv_nsec);
+        return 0;
+    }
+    return -1;
+}
+
+static int parse_job(const char *path, Job *job, char *out, char *error) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        snprintf(error, SPEC_LEN, "cannot open descriptor");
+        return -1;
+    }
+    char line[2 * SPEC_LEN], a_spec[SPEC_LEN] = "", b_spec[SPEC_LEN] = "";
+    memset(job, 0, sizeof(*job));
+    out[0] = '\0';
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *eq = strchr(line, '=');
+        if (line[0] == '#' || !eq) continue;
+        *eq = '\0';
+        const char *value = eq + 1;
+        if (strcmp(line, "n") == 0) job->n = atoi(value);
+        else if (strcmp(line, "a") == 0) snprintf(a_spec, SPEC_LEN, "%s", value);
+        else if (strcmp(line, "b") == 0) snprintf(b_spec, SPEC_LEN, "%s", value);
+        else if (strcmp(line, "out") == 0) snprintf(out, SPEC_LEN, "%s", value);
+        else if (strcmp(line, "op") == 0 && strcmp(value, "shutdown") == 0) job->op = OP_SHUTDOWN;
+    }
+    fclose(f);
+
+    if (job->op == OP_SHUTDOWN) return 0;
+    if (job->n <= 0) {
+        snprintf(error, SPEC_LEN, "missing or invalid n");
+        return -1;
+    }
+    if (operand_key(a_spec, job->a_key) != 0 || operand_key(b_spec, job->b_key) != 0) {
+        snprintf(error, SPEC_LEN, "invalid operand spec (use random:<seed> or file:<path>)");
+        return -1;
+    }
+    return 0;
+}
+
+/* Oldest *.job file of incoming/ (by name), 0 if there is none */
+static int next_job_file(const char *incoming, char *name) {
+    DIR *dir = opendir(incoming);
+    if (!dir) return 0;
+    struct dirent *e;
+    int found = 0;
+    while ((e = readdir(dir))) {
+        size_t len = strlen(e->d_name);
+        if (len < 5 || strcmp(e->d_name + len - 4, ".job") != 0 || len >= SPEC_LEN) continue;
+        if (!found || strcmp(e->d_name, name) < 0) {
+            strcpy(name, e->d_name);
+            found = 1;
+        }
+    }
+    closedir(dir);
+    return found;
+}
+
+/* Move the descriptor to done/ or failed/ and append its status */
+static void finish_job(const char *spool, const char *name, int ok, const char *status) {
+    char from[3 * SPEC_LEN], to[3 * SPEC_LEN];
+    snprintf(from, sizeof(from), "%s/incoming/%s", spool, name);
+    snprintf(to, sizeof(to), "%s/%s/%s", spool, ok ? "done" : "failed", name);
+    FILE *f = fopen(from, "a");
+    if (f) {
+        fprintf(f, "\n%s\n", status);
+        fclose(f);
+    }
+    if (rename(from, to) != 0) remove(from);
+}
+
+/*------------------------------------------------------------*/
+/* Operand cache and distribution                             */
+/*------------------------------------------------------------*/
+
+static CacheEntry *cache_lookup(Service *s, char role, const char *key, int n) {
+    for (int i = 0; i < CACHE_SLOTS; ++i) {
+        CacheEntry *e = &s->cache[i];
+        if (e->block && e->n == n && e->key[0] == role && strcmp(e->key + 1, key) == 0) {
+            e->last_use = ++s->clock;
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static CacheEntry *cache_victim(Service *s) {
+    CacheEntry *victim = &s->cache[0];
+    for (int i = 0; i < CACHE_SLOTS; ++i) {
+        if (!s->cache[i].block) return &s->cache[i];
+        if (s->cache[i].last_use < victim->last_use) victim = &s->cache[i];
+    }
+    return victim;
+}
+
+/* Rank 0: load the full operand from its spec; 0 on success */
+static int load_operand(Service *s, const char *key, int n) {
+    size_t elems = (size_t)n * n;
+    s->full = grow(s->full, &s->full_elems, elems);
+    if (!s->full) return -1;
+    if (strncmp(key, "random:", 7) == 0) {
+        fill_random(s->full, elems, (unsigned)strtoul(key + 7, NULL, 10));
+        return 0;
+    }
+    char path[KEY_LEN];
+    snprintf(path, sizeof(path), "%s", key + 5);
+    char *at = strrchr(path, '@');
+    if (at) *at = '\0';
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    size_t got = fread(s->full, sizeof(int), elems, f);
+    fclose(f);
+    return got == elems ? 0 : -1;
+}
+
+/* Distribute an operand, pre-skewed for Cannon, into a cache entry.
+   A block (i, j) is sent to grid position (i, j - i); B block (i, j) to
+   (i - j, j), which is where the initial alignment would move them. */
+static int distribute_operand(Service *s, char role, const char *key, int n, CacheEntry **out) {
+    CacheEntry *hit = cache_lookup(s, role, key, n);
+    if (hit) {
+        *out = hit;
+        return 1;
+    }
+
+    int block = n / s->q;
+    size_t block_elems = (size_t)block * block;
+    int status = 0;
+    if (s->rank == 0) {
+        status = load_operand(s, key, n);
+        if (status == 0) {
+            s->packed = grow(s->packed, &s->packed_elems, (size_t)s->size * block_elems);
+            if (!s->packed) status = -1;
+        }
+        for (int p = 0; status == 0 && p < s->size; ++p) {
+            int c[2];
+            MPI_Cart_coords(s->comm2d, p, 2, c);
+            int bi = role == 'A' ? c[0] : (c[0] + c[1]) % s->q;
+            int bj = role == 'A' ? (c[0] + c[1]) % s->q : c[1];
+            for (int r = 0; r < block; ++r)
+                memcpy(&s->packed[p * block_elems + (size_t)r * block],
+                       &s->full[((size_t)bi * block + r) * n + (size_t)bj * block],
+                       block * sizeof(int));
+        }
+    }
+    MPI_Bcast(&status, 1, MPI_INT, 0, s->comm2d);
+    if (status != 0) return -1;
+
+    CacheEntry *e = cache_victim(s);
+    if (e->n != n) {
+        free(e->block);
+        e->block = malloc(block_elems * sizeof(int));
+        if (!e->block) {
+            fprintf(stderr, "Rank %d: Memory allocation failure.\n", s->rank);
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+    }
+    e->n = n;
+    e->key[0] = role;
+    snprintf(e->key + 1, sizeof(e->key) - 1, "%s", key);
+    e->last_use = ++s->clock;
+    MPI_Scatter(s->packed, (int)block_elems, MPI_INT, e->block, (int)block_elems, MPI_INT, 0, s->comm2d);
+    *out = e;
+    return 0;
+}
+
+/*------------------------------------------------------------*/
+
+/* Run one multiplication; returns 0 on success, -1 if an operand failed */
+static int run_job(Service *s, const Job *job, const char *out, double *compute, long long *checksum,
+                   int *hits) {
+    int n = job->n, block = n / s->q;
+    size_t block_elems = (size_t)block * block;
+    CacheEntry *A, *B;
+
+    int hit_a = distribute_operand(s, 'A', job->a_key, n, &A);
+    if (hit_a < 0) return -1;
+    int hit_b = distribute_operand(s, 'B', job->b_key, n, &B);
+    if (hit_b < 0) return -1;
+    *hits = hit_a + 2 * hit_b;
+
+    s->Cblock = grow(s->Cblock, &s->Cblock_elems, block_elems);
+    if (!s->Cblock) {
+        fprintf(stderr, "Rank %d: Memory allocation failure.\n", s->rank);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    memset(s->Cblock, 0, block_elems * sizeof(int));
+
+    MPI_Barrier(s->comm2d);
+    double t0 = MPI_Wtime();
+    for (int step = 0; step < s->q; ++step) {
+        local_multiply(A->block, B->block, s->Cblock, block);
+        shift_matrix(A->block, block, 1, s->comm2d);
+        shift_matrix(B->block, block, 0, s->comm2d);
+    }
+    double local_elapsed = MPI_Wtime() - t0;
+    MPI_Reduce(&local_elapsed, compute, 1, MPI_DOUBLE, MPI_MAX, 0, s->comm2d);
+
+    long long local_sum = 0;
+    for (size_t e = 0; e < block_elems; ++e) local_sum += s->Cblock[e];
+    MPI_Reduce(&local_sum, checksum, 1, MPI_LONG_LONG, MPI_SUM, 0, s->comm2d);
+
+    /* Result file: gather the blocks and write C row-major */
+    int write_out = s->rank == 0 && out[0] != '\0';
+    MPI_Bcast(&write_out, 1, MPI_INT, 0, s->comm2d);
+    if (!write_out) return 0;
+
+    if (s->rank == 0) {
+        s->full = grow(s->full, &s->full_elems, (size_t)n * n);
+        s->packed = grow(s->packed, &s->packed_elems, (size_t)n * n);
+        if (!s->full || !s->packed) {
+            fprintf(stderr, "Root: Memory allocation failure.\n");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+    }
+    MPI_Gather(s->Cblock, (int)block_elems, MPI_INT, s->packed, (int)block_elems, MPI_INT, 0, s->comm2d);
+    if (s->rank == 0) {
+        for (int p = 0; p < s->size; ++p) {
+            int c[2];
+            MPI_Cart_coords(s->comm2d, p, 2, c);
+            for (int r = 0; r < block; ++r)
+                memcpy(&s->full[((size_t)c[0] * block + r) * n + (size_t)c[1] * block],
+                       &s->packed[p * block_elems + (size_t)r * block],
+                       block * sizeof(int));
+        }
+        FILE *f = fopen(out, "wb");
+        if (!f || fwrite(s->full, sizeof(int), (size_t)n * n, f) != (size_t)n * n) {
+            fprintf(stderr, "Service: cannot write result \"%s\".\n", out);
+        }
+        if (f) fclose(f);
+    }
+    return 0;
+}
+
+/* Rank 0: block until a valid job is available, handling invalid ones */
+static void wait_for_job(const char *spool, int inotify_fd, Job *job, char *name, char *out) {
+    char incoming[2 * SPEC_LEN], path[3 * SPEC_LEN], error[SPEC_LEN];
+    snprintf(incoming, sizeof(incoming), "%s/incoming", spool);
+    for (;;) {
+        while (next_job_file(incoming, name)) {
+            snprintf(path, sizeof(path), "%s/%s", incoming, name);
+            if (parse_job(path, job, out, error) == 0) return;
+            char status[2 * SPEC_LEN];
+            snprintf(status, sizeof(status), "status=failed\nerror=%s", error);
+            finish_job(spool, name, 0, status);
+        }
+        /* Nothing queued: sleep until a file shows up (or rescan every second) */
+        struct pollfd pfd = {inotify_fd, POLLIN, 0};
+        if (inotify_fd >= 0 && poll(&pfd, 1, 1000) > 0) {
+            char events[4096];
+            if (read(inotify_fd, events, sizeof(events)) < 0) perror("inotify");
+        } else if (inotify_fd < 0) {
+            struct timespec ts = {0, 50 * 1000 * 1000};
+            nanosleep(&ts, NULL);
+        }
+    }
+}
+
+/* Broadcast the next job; the other ranks wait for it without spinning on a core */
+static void receive_job(Job *job, MPI_Comm comm) {
+    MPI_Request req;
+    int arrived = 0;
+    struct timespec ts = {0, 1000 * 1000};
+    MPI_Ibcast(job, sizeof(*job), MPI_BYTE, 0, comm, &req);
+    MPI_Test(&req, &arrived, MPI_STATUS_IGNORE);
+    while (!arrived) {
+        nanosleep(&ts, NULL);
+        MPI_Test(&req, &arrived, MPI_STATUS_IGNORE);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    MPI_Init(&argc, &argv);
+
+    Service s;
+    memset(&s, 0, sizeof(s));
+    MPI_Comm_rank(MPI_COMM_WORLD, &s.rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &s.size);
+
+    s.q = (int)sqrt(s.size);
+    if (s.q * s.q != s.size) {
+        if (s.rank == 0) fprintf(stderr, "El número de procesos debe ser un cuadrado perfecto.\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    int dims[2] = {s.q, s.q}, periods[2] = {1, 1};
+    MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, &s.comm2d);
+    MPI_Comm_rank(s.comm2d, &s.rank);
+    MPI_Cart_coords(s.comm2d, s.rank, 2, s.coords);
+
+    const char *spool = argc > 1 ? argv[1] : "spool";
+    int inotify_fd = -1;
+    if (s.rank == 0) {
+        char dir[2 * SPEC_LEN];
+        mkdir(spool, 0755);
+        const char *subdirs[] = {"incoming", "done", "failed"};
+        for (int i = 0; i < 3; ++i) {
+            snprintf(dir, sizeof(dir), "%s/%s", spool, subdirs[i]);
+            mkdir(dir, 0755);
+        }
+        snprintf(dir, sizeof(dir), "%s/incoming", spool);
+        inotify_fd = inotify_init1(IN_NONBLOCK);
+        if (inotify_fd >= 0 && inotify_add_watch(inotify_fd, dir, IN_MOVED_TO | IN_CLOSE_WRITE) < 0) {
+            close(inotify_fd);
+            inotify_fd = -1;
+        }
+        printf("Matmul service up on %d process(es) (%dx%d grid), spool %s\n", s.size, s.q, s.q, spool);
+        fflush(stdout);
+    }
+
+    for (;;) {
+        Job job;
+        char name[SPEC_LEN] = "", out[SPEC_LEN] = "";
+        if (s.rank == 0) {
+            wait_for_job(spool, inotify_fd, &job, name, out);
+            if (job.op == OP_MULTIPLY && job.n % s.q != 0) {
+                char status[SPEC_LEN];
+                snprintf(status, sizeof(status), "status=failed\nerror=n (%d) must be divisible by %d", job.n, s.q);
+                finish_job(spool, name, 0, status);
+                continue;
+            }
+        }
+        receive_job(&job, s.comm2d);
+
+        if (job.op == OP_SHUTDOWN) {
+            if (s.rank == 0) finish_job(spool, name, 1, "status=ok");
+            break;
+        }
+
+        double t0 = MPI_Wtime(), compute = 0.0;
+        long long checksum = 0;
+        int hits = 0;
+        int rc = run_job(&s, &job, out, &compute, &checksum, &hits);
+
+        if (s.rank == 0) {
+            char status[2 * SPEC_LEN];
+            double total = MPI_Wtime() - t0;
+            if (rc == 0) {
+                snprintf(status, sizeof(status),
+                         "status=ok\nseconds=%.6f\ncompute_seconds=%.6f\nchecksum=%lld\na_cached=%d\nb_cached=%d",
+                         total, compute, checksum, hits & 1, hits >> 1);
+                printf("Job %s: %dx%d in %.6f s (Cannon %.6f s, A %s, B %s)\n", name, job.n, job.n, total,
+                       compute, (hits & 1) ? "cached" : "sent", (hits >> 1) ? "cached" : "sent");
+            } else {
+                snprintf(status, sizeof(status), "status=failed\nerror=cannot load operand");
+                printf("Job %s: failed to load an operand\n", name);
+            }
+            fflush(stdout);
+            finish_job(spool, name, rc == 0, status);
+        }
+    }
+
+    for (int i = 0; i < CACHE_SLOTS; ++i) free(s.cache[i].block);
+    free(s.Cblock);
+    free(s.full);
+    free(s.packed);
+    if (inotify_fd >= 0) close(inotify_fd);
+    MPI_Comm_free(&s.comm2d);
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,201 @@
+/*
+ * Aligned, huge-page and NUMA aware allocation of matrix buffers, see
+ * matrix_alloc.h
+ *
+ * Every buffer has a small record, kept apart from the buffer so that a
+ * 2 MiB request maps exactly one huge page, in the list of live buffers.
+ */
+
+#define _GNU_SOURCE
+#include "matrix_alloc.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define ALIGNMENT 64
+#define HUGE_PAGE ((size_t)2 << 20)
+#define MPOL_LOCAL 4                /* linux/mempolicy.h */
+#define SAMPLE_PAGES 256            /* pages per buffer checked for locality */
+
+enum { KIND_MALLOC, KIND_MMAP, KIND_MPI };
+
+typedef struct Buffer {
+    void *ptr;                      /* what the caller got                  */
+    void *base;                     /* what to give back to free/munmap     */
+    size_t map_bytes;               /* mapped length (KIND_MMAP)            */
+    size_t bytes;                   /* requested length                     */
+    int kind;
+    struct Buffer *next;
+} Buffer;
+
+static Buffer *live;
+
+/*------------------------------------------------------------*/
+
+static int hugepage_mode(void) {
+    const char *mode = getenv("MATRIX_HUGEPAGES");
+    if (!mode || strcmp(mode, "thp") == 0) return 1;
+    return strcmp(mode, "hugetlb") == 0 ? 2 : 0;
+}
+
+/* Map bytes with a 2 MiB aligned start; returns the base and sets *map_bytes */
+static char *map_huge(size_t bytes, int mode, size_t *map_bytes) {
+    size_t len = (bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+    if (mode == 2) {
+        char *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            *map_bytes = len;
+            return p;
+        }
+    }
+    /* Over-map by one huge page and trim both ends to the aligned range */
+    char *raw = mmap(NULL, len + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return NULL;
+    char *p = (char *)(((uintptr_t)raw + HUGE_PAGE - 1) & ~(uintptr_t)(HUGE_PAGE - 1));
+    if (p > raw) munmap(raw, (size_t)(p - raw));
+    if (raw + len + HUGE_PAGE > p + len) munmap(p + len, (size_t)(raw + len + HUGE_PAGE - (p + len)));
+#ifdef MADV_HUGEPAGE
+    madvise(p, len, MADV_HUGEPAGE);
+#endif
+    *map_bytes = len;
+    return p;
+}
+
+void *matrix_alloc(size_t bytes) {
+    Buffer *b = calloc(1, sizeof(*b));
+    char *base = NULL, *ptr;
+    int mode = hugepage_mode();
+    if (!b) return NULL;
+
+    if (getenv("MATRIX_MPI_ALLOC") && atoi(getenv("MATRIX_MPI_ALLOC"))) {
+        if (MPI_Alloc_mem((MPI_Aint)(bytes + ALIGNMENT), MPI_INFO_NULL, &base) != MPI_SUCCESS) base = NULL;
+        b->kind = KIND_MPI;
+        ptr = (char *)(((uintptr_t)base + ALIGNMENT - 1) & ~(uintptr_t)(ALIGNMENT - 1));
+    } else if (mode != 0 && bytes >= HUGE_PAGE) {
+        base = map_huge(bytes, mode, &b->map_bytes);
+        b->kind = KIND_MMAP;
+        ptr = base;
+        /* Best effort: keep the pages on the faulting CPU's node even if the
+           process inherited an interleave or bind policy */
+        if (base) syscall(SYS_mbind, base, b->map_bytes, MPOL_LOCAL, NULL, 0UL, 0U);
+    } else {
+        if (posix_memalign((void **)&base, ALIGNMENT, bytes ? bytes : 1) != 0) base = NULL;
+        b->kind = KIND_MALLOC;
+        ptr = base;
+    }
+    if (!base) {
+        free(b);
+        return NULL;
+    }
+
+    /* First touch by the owning rank places every page on its node */
+    memset(ptr, 0, bytes);
+
+    b->ptr = ptr;
+    b->base = base;
+    b->bytes = bytes;
+    b->next = live;
+    live = b;
+    return ptr;
+}
+
+void matrix_free(void *ptr) {
+    if (!ptr) return;
+    Buffer **link = &live;
+    while (*link && (*link)->ptr != ptr) link = &(*link)->next;
+    Buffer *b = *link;
+    if (!b) return;
+    *link = b->next;
+
+    if (b->kind == KIND_MMAP) munmap(b->base, b->map_bytes);
+    else if (b->kind == KIND_MPI) MPI_Free_mem(b->base);
+    else free(b->base);
+    free(b);
+}
+
+/*------------------------------------------------------------*/
+
+/* Huge-page backed bytes of the mapped buffers, from /proc/self/smaps.
+   Neighbouring mappings merge into one VMA, so each VMA contributes at most
+   the bytes it shares with the buffers. */
+static double anon_huge_bytes(void) {
+    FILE *f = fopen("/proc/self/smaps", "r");
+    if (!f) return 0.0;
+    char line[256];
+    double overlap = 0.0, total = 0.0;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long lo, hi, kb;
+        if (sscanf(line, "%lx-%lx ", &lo, &hi) == 2) {
+            overlap = 0.0;
+            for (const Buffer *b = live; b; b = b->next) {
+                if (b->kind != KIND_MMAP) continue;
+                uintptr_t s0 = (uintptr_t)b->base, s1 = s0 + b->map_bytes;
+                uintptr_t a = s0 > lo ? s0 : lo, e = s1 < hi ? s1 : hi;
+                if (e > a) overlap += (double)(e - a);
+            }
+        } else if (overlap > 0 && (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1 ||
+                                   sscanf(line, "Private_Hugetlb: %lu kB", &kb) == 1)) {
+            total += kb * 1024.0 < overlap ? kb * 1024.0 : overlap;
+        }
+    }
+    fclose(f);
+    return total;
+}
+
+/* Sampled pages of the buffer: how many were found, how many on node */
+static void page_locality(const Buffer *b, int node, double *pages, double *local) {
+    long page = sysconf(_SC_PAGESIZE);
+    char *first = b->ptr;
+    size_t npages = (b->bytes + (size_t)page - 1) / (size_t)page;
+    size_t step = npages > SAMPLE_PAGES ? npages / SAMPLE_PAGES : 1;
+    void *addr[SAMPLE_PAGES];
+    int status[SAMPLE_PAGES];
+    unsigned long count = 0;
+    for (size_t p = 0; p < npages && count < SAMPLE_PAGES; p += step) addr[count++] = first + p * (size_t)page;
+    if (syscall(SYS_move_pages, 0, count, addr, NULL, status, 0) != 0) return;
+    for (unsigned long i = 0; i < count; ++i) {
+        if (status[i] < 0) continue;
+        *pages += 1;
+        *local += status[i] == node;
+    }
+}
+
+void matrix_alloc_report(MPI_Comm comm, const char *title) {
+    if (!getenv("MATRIX_ALLOC_REPORT") || !atoi(getenv("MATRIX_ALLOC_REPORT"))) return;
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    unsigned cpu = 0, node = 0;
+    syscall(SYS_getcpu, &cpu, &node, NULL);
+
+    /* buffers, bytes, huge bytes, sampled pages, local pages */
+    double local[5] = {0}, sum[5], min_local_share;
+    for (const Buffer *b = live; b; b = b->next) {
+        local[0] += 1;
+        local[1] += b->bytes;
+        page_locality(b, (int)node, &local[3], &local[4]);
+    }
+    local[2] = anon_huge_bytes();
+    double share = local[3] > 0 ? local[4] / local[3] : 1.0;
+    MPI_Reduce(local, sum, 5, MPI_DOUBLE, MPI_SUM, 0, comm);
+    MPI_Reduce(&share, &min_local_share, 1, MPI_DOUBLE, MPI_MIN, 0, comm);
+    if (rank != 0) return;
+
+    const char *mode = getenv("MATRIX_HUGEPAGES") ? getenv("MATRIX_HUGEPAGES") : "thp";
+    int mpi_alloc = getenv("MATRIX_MPI_ALLOC") && atoi(getenv("MATRIX_MPI_ALLOC"));
+    printf("Matrix buffers: %s (%d process(es), huge pages %s%s)\n", title, size, mode,
+           mpi_alloc ? ", MPI_Alloc_mem" : "");
+    printf("  %.0f live buffer(s), %.1f MiB, %.1f%% in huge pages\n", sum[0], sum[1] / (1024 * 1024),
+           sum[1] > 0 ? 100.0 * sum[2] / sum[1] : 0.0);
+    if (sum[3] > 0)
+        printf("  pages on the rank's own NUMA node: %.1f%% (worst rank %.1f%%, %.0f pages sampled)\n",
+               100.0 * sum[4] / sum[3], 100.0 * min_local_share, sum[3]);
+    else
+        printf("  NUMA placement unavailable (move_pages not permitted)\n");
+}
@@ -0,0 +1,46 @@
+/*
+ * Aligned, huge-page and NUMA aware allocation of matrix buffers
+ * ----------------------------------------------------------------
+ *  - Purpose: Replace the drivers' plain malloc/calloc for the blocks, whose
+ *    buffers were unaligned for SIMD, backed by 4 KiB pages (TLB misses at
+ *    large N) and placed wherever the first toucher lived.
+ *  - Features:
+ *      • 64-byte aligned buffers, zeroed
+ *      • Buffers of at least 2 MiB are mapped on their own, 2 MiB aligned,
+ *        and backed by transparent huge pages (madvise) or by the hugetlbfs
+ *        pool (MAP_HUGETLB), falling back to 4 KiB pages
+ *      • Local NUMA policy (mbind MPOL_LOCAL) and first-touch: the calling
+ *        rank faults every page in when it zeroes the buffer, so pages land
+ *        on the node the rank runs on, and every rank does it at once
+ *      • Optional MPI_Alloc_mem, so that the MPI library can hand out
+ *        memory it has already registered with the network
+ *      • Report of live buffers: bytes, share backed by huge pages and share
+ *        of sampled pages that sit on the rank's own node
+ *
+ *  Environment
+ *  -----------
+ *      MATRIX_HUGEPAGES    thp (default), hugetlb, or off
+ *      MATRIX_MPI_ALLOC    1 allocates through MPI_Alloc_mem instead
+ *      MATRIX_ALLOC_REPORT 1 makes matrix_alloc_report() print
+ *
+ *  Notes
+ *  -----
+ *      • MAP_HUGETLB needs a preallocated pool (vm.nr_hugepages) on the
+ *        host; Docker containers share the host's pool.
+ *      • With MATRIX_MPI_ALLOC=1 the library decides the page size and
+ *        placement; only alignment is guaranteed.
+ *      • Allocate after MPI_Init and free before MPI_Finalize.
+ *      • dTLB misses per phase are counted by perf_regions.c.
+ */
+
+#ifndef MATRIX_ALLOC_H
+#define MATRIX_ALLOC_H
+
+#include <mpi.h>
+#include <stddef.h>
+
+void *matrix_alloc(size_t bytes);
+void matrix_free(void *ptr);
+void matrix_alloc_report(MPI_Comm comm, const char *title);
+
+#endif
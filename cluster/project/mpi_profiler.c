@@ -0,0 +1,771 @@
+/*
+ * PMPI communication profiler for the MPI programs of this project
+ * -----------------------------------------------------------------
+ *  - Purpose: Tell how much of a run is spent inside MPI (and in which
+ *    call, with which peer) versus computing, without touching the
+ *    programs, and say where a rank is stuck when a run hangs.
+ *  - Features:
+ *      • Intercepts the point-to-point, collective, non-blocking and
+ *        one-sided (RMA) calls used in this project through the PMPI
+ *        interface
+ *      • Per call: count, time, bytes and a log2 histogram of durations
+ *      • Rank x rank traffic matrix of the bytes each rank sends
+ *      • Chrome trace / Perfetto JSON timeline of every intercepted call
+ *      • Optional hang watchdog: reports the call a rank is blocked in
+ *
+ *  Build & use examples
+ *  --------------------
+ *      mpicc -O2 -shared -fPIC -o libmpiprof.so mpi_profiler.c -lpthread
+ *      mpirun -np 16 -env LD_PRELOAD /project/libmpiprof.so ./cannons_algorithm
+ *      mpicc -o cannons_algorithm cannons_algorithm.c -L. -lmpiprof   # or link it
+ *
+ *  Output (written by rank 0 at MPI_Finalize)
+ *  ------------------------------------------
+ *      <prefix>_summary.txt    per-call totals, histograms, per-rank MPI share
+ *      <prefix>_traffic.csv    bytes sent from row rank to column rank
+ *      <prefix>_trace.json     timeline, open in ui.perfetto.dev or chrome://tracing
+ *
+ *  Environment
+ *  -----------
+ *      MPIPROF_PREFIX          output prefix (default "mpiprof")
+ *      MPIPROF_MAX_EVENTS      timeline events kept per rank (default 100000,
+ *                              0 disables the timeline)
+ *      MPIPROF_HANG_SECONDS    report calls blocked longer than this (default
+ *                              0 = off); the watchdog is a thread, so when
+ *                              set MPI_Init asks for MPI_THREAD_FUNNELED.
+ *                              SIGUSR1 reports the current call at any time
+ *
+ *  Notes
+ *  -----
+ *      • Collectives are counted in the traffic matrix by their logical data
+ *        movement (root to every rank for Bcast/Scatter, every rank to root
+ *        for Gather/Reduce); Allreduce, Allgather and Barrier only appear in
+ *        the per-call statistics because their pattern depends on MPICH's
+ *        algorithm choice.
+ *      • Each intercepted call costs two clock reads and a few stores; the
+ *        timeline is a preallocated array, so nothing is written to disk
+ *        before MPI_Finalize. Peers are translated to world ranks through a
+ *        table cached as a communicator (or window) attribute.
+ *      • Polling calls (MPI_Test, MPI_Iprobe) are recorded like any other;
+ *        a busy polling loop can fill the timeline quickly.
+ */
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define HIST_BINS 24   /* <1us, [1,2)us, [2,4)us ... >= 2^22 us */
+
+enum {
+    CALL_SEND, CALL_RECV, CALL_ISEND, CALL_IRECV, CALL_WAIT, CALL_WAITALL,
+    CALL_SENDRECV, CALL_SENDRECV_REPLACE, CALL_BCAST, CALL_SCATTER, CALL_SCATTERV,
+    CALL_GATHER, CALL_GATHERV, CALL_REDUCE, CALL_ALLREDUCE, CALL_IALLREDUCE,
+    CALL_ALLGATHER, CALL_ALLGATHERV, CALL_BARRIER, CALL_TEST, CALL_IPROBE, CALL_IBARRIER,
+    CALL_IBCAST, CALL_ACCUMULATE, CALL_FETCH_AND_OP, CALL_WIN_FLUSH, NCALLS
+};
+
+static const char *call_names[NCALLS] = {
+    "MPI_Send", "MPI_Recv", "MPI_Isend", "MPI_Irecv", "MPI_Wait", "MPI_Waitall",
+    "MPI_Sendrecv", "MPI_Sendrecv_replace", "MPI_Bcast", "MPI_Scatter", "MPI_Scatterv",
+    "MPI_Gather", "MPI_Gatherv", "MPI_Reduce", "MPI_Allreduce", "MPI_Iallreduce",
+    "MPI_Allgather", "MPI_Allgatherv", "MPI_Barrier", "MPI_Test", "MPI_Iprobe", "MPI_Ibarrier",
+    "MPI_Ibcast", "MPI_Accumulate", "MPI_Fetch_and_op", "MPI_Win_flush"
+};
+
+typedef struct {
+    long count;
+    double time;
+    double bytes;
+    long hist[HIST_BINS];
+} CallStats;
+
+typedef struct {
+    double start, dur;   /* seconds since MPI_Init */
+    int call, peer;      /* peer as world rank, -1 if none */
+    long bytes;
+} Event;
+
+static int prof_rank = -1, prof_size = 0;
+static double prof_t0;
+static CallStats stats[NCALLS];
+static double *traffic;             /* bytes sent to each world rank */
+static Event *events;
+static long n_events, max_events, dropped_events;
+static MPI_Group world_group;
+static int comm_keyval = MPI_KEYVAL_INVALID, win_keyval = MPI_KEYVAL_INVALID;
+
+/* Current call, read by the watchdog thread and the SIGUSR1 handler */
+static volatile int cur_call = -1, cur_peer = -1;
+static volatile double cur_start;
+static volatile int cur_reported;
+static double hang_seconds;
+static pthread_t watchdog;
+static volatile int watchdog_stop;
+
+/*------------------------------------------------------------*/
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static long type_bytes(MPI_Datatype type, int count) {
+    int size;
+    PMPI_Type_size(type, &size);
+    return (long)size * count;
+}
+
+/* World rank of every rank of group, -1 where undefined; table[0] is the
+   group size */
+static int *translation_table(MPI_Group group) {
+    int size;
+    PMPI_Group_size(group, &size);
+    int *table = malloc((size + 1) * sizeof(int)), *ranks = malloc(size * sizeof(int));
+    if (!table || !ranks) {
+        free(table);
+        free(ranks);
+        return NULL;
+    }
+    for (int r = 0; r < size; ++r) ranks[r] = r;
+    PMPI_Group_translate_ranks(group, size, ranks, world_group, table + 1);
+    for (int r = 0; r < size; ++r)
+        if (table[r + 1] == MPI_UNDEFINED) table[r + 1] = -1;
+    table[0] = size;
+    free(ranks);
+    return table;
+}
+
+static int free_comm_table(MPI_Comm comm, int keyval, void *table, void *extra) {
+    (void)comm, (void)keyval, (void)extra;
+    free(table);
+    return MPI_SUCCESS;
+}
+
+static int free_win_table(MPI_Win win, int keyval, void *table, void *extra) {
+    (void)win, (void)keyval, (void)extra;
+    free(table);
+    return MPI_SUCCESS;
+}
+
+static int lookup(const int *table, int peer) {
+    return table && peer >= 0 && peer < table[0] ? table[peer + 1] : -1;
+}
+
+/* The table is built on first use of a communicator and freed with it */
+static int world_peer(int peer, MPI_Comm comm) {
+    if (peer < 0 || comm == MPI_COMM_WORLD) return peer;
+    int *table, found;
+    PMPI_Comm_get_attr(comm, comm_keyval, &table, &found);
+    if (!found) {
+        MPI_Group group;
+        PMPI_Comm_group(comm, &group);
+        table = translation_table(group);
+        PMPI_Group_free(&group);
+        if (table) PMPI_Comm_set_attr(comm, comm_keyval, table);
+    }
+    return lookup(table, peer);
+}
+
+static int win_peer(int target, MPI_Win win) {
+    int *table, found;
+    PMPI_Win_get_attr(win, win_keyval, &table, &found);
+    if (!found) {
+        MPI_Group group;
+        PMPI_Win_get_group(win, &group);
+        table = translation_table(group);
+        PMPI_Group_free(&group);
+        if (table) PMPI_Win_set_attr(win, win_keyval, table);
+    }
+    return lookup(table, target);
+}
+
+static double enter(int call, int peer) {
+    double t = now();
+    cur_start = t;
+    cur_peer = peer;
+    cur_reported = 0;
+    cur_call = call;
+    return t;
+}
+
+static void leave(int call, double start, int peer, long bytes) {
+    double dur = now() - start;
+    cur_call = -1;
+
+    CallStats *s = &stats[call];
+    s->count++;
+    s->time += dur;
+    s->bytes += bytes;
+    int bin = dur < 1e-6 ? 0 : 1 + (int)log2(dur * 1e6);
+    s->hist[bin < HIST_BINS ? bin : HIST_BINS - 1]++;
+
+    if (n_events < max_events) {
+        Event *e = &events[n_events++];
+        e->start = start - prof_t0;
+        e->dur = dur;
+        e->call = call;
+        e->peer = peer;
+        e->bytes = bytes;
+    } else if (max_events > 0) {
+        dropped_events++;
+    }
+}
+
+static void add_traffic(int peer, double bytes) {
+    if (traffic && peer >= 0 && peer < prof_size) traffic[peer] += bytes;
+}
+
+/*------------------------------------------------------------*/
+/* Hang reporting                                             */
+/*------------------------------------------------------------*/
+
+/* The report is also made from the SIGUSR1 handler, so it is formatted by
+   hand and written with write(): no stdio, no locks, no allocation */
+static size_t put_str(char *msg, size_t pos, size_t len, const char *str) {
+    while (*str && pos + 1 < len) msg[pos++] = *str++;
+    return pos;
+}
+
+static size_t put_long(char *msg, size_t pos, size_t len, long value, int min_digits) {
+    char digits[24];
+    int n = 0;
+    unsigned long v = value < 0 ? 0UL - (unsigned long)value : (unsigned long)value;
+    do {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v || n < min_digits);
+    if (value < 0 && pos + 1 < len) msg[pos++] = '-';
+    while (n > 0 && pos + 1 < len) msg[pos++] = digits[--n];
+    return pos;
+}
+
+static void report_current_call(const char *why) {
+    char msg[256];
+    int call = cur_call;
+    size_t pos = put_str(msg, 0, sizeof(msg), "[mpiprof] rank ");
+    pos = put_long(msg, pos, sizeof(msg), prof_rank, 1);
+    pos = put_str(msg, pos, sizeof(msg), " (");
+    pos = put_str(msg, pos, sizeof(msg), why);
+    if (call < 0) {
+        pos = put_str(msg, pos, sizeof(msg), "): not in MPI\n");
+    } else {
+        long ms = (long)((now() - cur_start) * 1e3 + 0.5);
+        pos = put_str(msg, pos, sizeof(msg), "): in ");
+        pos = put_str(msg, pos, sizeof(msg), call_names[call]);
+        pos = put_str(msg, pos, sizeof(msg), " for ");
+        pos = put_long(msg, pos, sizeof(msg), ms / 1000, 1);
+        pos = put_str(msg, pos, sizeof(msg), ".");
+        pos = put_long(msg, pos, sizeof(msg), ms % 1000, 3);
+        pos = put_str(msg, pos, sizeof(msg), " s, peer ");
+        pos = put_long(msg, pos, sizeof(msg), cur_peer, 1);
+        pos = put_str(msg, pos, sizeof(msg), "\n");
+    }
+    ssize_t ignored = write(STDERR_FILENO, msg, pos);
+    (void)ignored;
+}
+
+static void on_sigusr1(int sig) {
+    (void)sig;
+    report_current_call("SIGUSR1");
+}
+
+static void *watchdog_main(void *arg) {
+    (void)arg;
+    while (!watchdog_stop) {
+        sleep(1);
+        if (cur_call >= 0 && !cur_reported && now() - cur_start > hang_seconds) {
+            cur_reported = 1;
+            report_current_call("watchdog");
+        }
+    }
+    return NULL;
+}
+
+/*------------------------------------------------------------*/
+/* Setup and reports                                          */
+/*------------------------------------------------------------*/
+
+static void prof_setup(int provided) {
+    PMPI_Comm_rank(MPI_COMM_WORLD, &prof_rank);
+    PMPI_Comm_size(MPI_COMM_WORLD, &prof_size);
+    PMPI_Comm_group(MPI_COMM_WORLD, &world_group);
+    PMPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, free_comm_table, &comm_keyval, NULL);
+    PMPI_Win_create_keyval(MPI_WIN_NULL_COPY_FN, free_win_table, &win_keyval, NULL);
+
+    const char *env = getenv("MPIPROF_MAX_EVENTS");
+    max_events = env ? atol(env) : 100000;
+    if (max_events > 0) {
+        events = malloc(max_events * sizeof(Event));
+        if (!events) max_events = 0;
+    }
+    traffic = calloc(prof_size, sizeof(double));
+
+    signal(SIGUSR1, on_sigusr1);
+    env = getenv("MPIPROF_HANG_SECONDS");
+    hang_seconds = env ? atof(env) : 0.0;
+    /* Under MPI_THREAD_SINGLE the process may not have a second thread */
+    if (hang_seconds > 0 && provided < MPI_THREAD_FUNNELED) {
+        if (prof_rank == 0)
+            fprintf(stderr, "[mpiprof] MPIPROF_HANG_SECONDS ignored: the library only provides "
+                            "MPI_THREAD_SINGLE; use SIGUSR1 instead\n");
+        hang_seconds = 0;
+    }
+    if (hang_seconds > 0 && pthread_create(&watchdog, NULL, watchdog_main, NULL) != 0) hang_seconds = 0;
+
+    PMPI_Barrier(MPI_COMM_WORLD);
+    prof_t0 = now();
+}
+
+static void output_path(char *path, size_t len, const char *suffix) {
+    const char *prefix = getenv("MPIPROF_PREFIX");
+    snprintf(path, len, "%s_%s", prefix ? prefix : "mpiprof", suffix);
+}
+
+static void write_summary(double wall) {
+    double per_call[NCALLS], sum_time[NCALLS], max_time[NCALLS], sum_bytes[NCALLS];
+    long sum_count[NCALLS], hist[NCALLS * HIST_BINS], local_hist[NCALLS * HIST_BINS];
+    double mpi_time = 0.0;
+    long local_count[NCALLS];
+    for (int c = 0; c < NCALLS; ++c) {
+        per_call[c] = stats[c].time;
+        local_count[c] = stats[c].count;
+        sum_bytes[c] = stats[c].bytes;
+        memcpy(&local_hist[c * HIST_BINS], stats[c].hist, sizeof(stats[c].hist));
+        mpi_time += stats[c].time;
+    }
+    PMPI_Reduce(per_call, sum_time, NCALLS, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    PMPI_Reduce(per_call, max_time, NCALLS, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    PMPI_Reduce(local_count, sum_count, NCALLS, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    PMPI_Reduce(prof_rank == 0 ? MPI_IN_PLACE : sum_bytes, sum_bytes, NCALLS, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    PMPI_Reduce(local_hist, hist, NCALLS * HIST_BINS, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    double local[2] = {wall, mpi_time}, *ranks = NULL;
+    if (prof_rank == 0) ranks = malloc(2 * prof_size * sizeof(double));
+    PMPI_Gather(local, 2, MPI_DOUBLE, ranks, 2, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (prof_rank != 0) return;
+
+    char path[512];
+    output_path(path, sizeof(path), "summary.txt");
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "[mpiprof] cannot write %s\n", path);
+        free(ranks);
+        return;
+    }
+    fprintf(f, "MPI profile of %d process(es)\n\n", prof_size);
+    fprintf(f, "%-22s %10s %14s %14s %16s\n", "call", "count", "time sum (s)", "time max (s)", "bytes");
+    for (int c = 0; c < NCALLS; ++c) {
+        if (sum_count[c] == 0) continue;
+        fprintf(f, "%-22s %10ld %14.6f %14.6f %16.0f\n", call_names[c], sum_count[c], sum_time[c], max_time[c],
+                sum_bytes[c]);
+    }
+
+    fprintf(f, "\nPer rank (wall time from MPI_Init to MPI_Finalize)\n");
+    fprintf(f, "%6s %12s %12s %8s\n", "rank", "wall (s)", "in MPI (s)", "MPI %");
+    for (int r = 0; r < prof_size; ++r)
+        fprintf(f, "%6d %12.6f %12.6f %7.1f%%\n", r, ranks[2 * r], ranks[2 * r + 1],
+                ranks[2 * r] > 0 ? 100.0 * ranks[2 * r + 1] / ranks[2 * r] : 0.0);
+
+    fprintf(f, "\nDuration histograms (calls per bin, all ranks)\n");
+    for (int c = 0; c < NCALLS; ++c) {
+        if (sum_count[c] == 0) continue;
+        fprintf(f, "%s\n", call_names[c]);
+        for (int b = 0; b < HIST_BINS; ++b) {
+            if (hist[c * HIST_BINS + b] == 0) continue;
+            if (b == 0) fprintf(f, "  %12s", "< 1 us");
+            else if (b == HIST_BINS - 1) fprintf(f, "  >= %9.0f us", ldexp(1.0, b - 1));
+            else fprintf(f, "  %5.0f-%5.0f us", ldexp(1.0, b - 1), ldexp(1.0, b));
+            fprintf(f, " %10ld\n", hist[c * HIST_BINS + b]);
+        }
+    }
+    fclose(f);
+    free(ranks);
+}
+
+static void write_traffic(void) {
+    double *matrix = NULL;
+    if (prof_rank == 0) matrix = malloc((size_t)prof_size * prof_size * sizeof(double));
+    PMPI_Gather(traffic, prof_size, MPI_DOUBLE, matrix, prof_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (prof_rank != 0) return;
+
+    char path[512];
+    output_path(path, sizeof(path), "traffic.csv");
+    FILE *f = fopen(path, "w");
+    if (f) {
+        fprintf(f, "from\\to");
+        for (int c = 0; c < prof_size; ++c) fprintf(f, ",%d", c);
+        fprintf(f, "\n");
+        for (int r = 0; r < prof_size; ++r) {
+            fprintf(f, "%d", r);
+            for (int c = 0; c < prof_size; ++c) fprintf(f, ",%.0f", matrix[(size_t)r * prof_size + c]);
+            fprintf(f, "\n");
+        }
+        fclose(f);
+    } else {
+        fprintf(stderr, "[mpiprof] cannot write %s\n", path);
+    }
+    free(matrix);
+}
+
+static void write_events(FILE *f, const Event *ev, long count, int rank, int *first) {
+    for (long i = 0; i < count; ++i) {
+        fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f,"
+                   "\"args\":{\"peer\":%d,\"bytes\":%ld}}",
+                *first ? "" : ",", call_names[ev[i].call], rank, ev[i].start * 1e6, ev[i].dur * 1e6,
+                ev[i].peer, ev[i].bytes);
+        *first = 0;
+    }
+}
+
+/* Rank 0 receives the timelines one rank at a time to bound its memory */
+static void write_trace(void) {
+    int enabled = max_events > 0;
+    PMPI_Allreduce(MPI_IN_PLACE, &enabled, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (!enabled) return;
+
+    if (prof_rank != 0) {
+        long header[2] = {n_events, dropped_events};
+        PMPI_Send(header, 2, MPI_LONG, 0, 0, MPI_COMM_WORLD);
+        if (n_events > 0)
+            PMPI_Send(events, (int)(n_events * sizeof(Event)), MPI_BYTE, 0, 0, MPI_COMM_WORLD);
+        return;
+    }
+
+    char path[512];
+    output_path(path, sizeof(path), "trace.json");
+    FILE *f = fopen(path, "w");
+    if (!f) fprintf(stderr, "[mpiprof] cannot write %s\n", path);
+    if (f) fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    int first = 1;
+    long dropped = dropped_events;
+    if (f) write_events(f, events, n_events, 0, &first);
+    for (int r = 1; r < prof_size; ++r) {
+        long header[2];
+        PMPI_Recv(header, 2, MPI_LONG, r, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        dropped += header[1];
+        if (header[0] == 0) continue;
+        Event *remote = malloc(header[0] * sizeof(Event));
+        PMPI_Recv(remote, (int)(header[0] * sizeof(Event)), MPI_BYTE, r, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        if (f) write_events(f, remote, header[0], r, &first);
+        free(remote);
+    }
+    if (f) {
+        for (int r = 0; r < prof_size; ++r)
+            fprintf(f, "%s\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"rank %d\"}}",
+                    first && r == 0 ? "" : ",", r, r);
+        fprintf(f, "\n]}\n");
+        fclose(f);
+    }
+    if (dropped > 0)
+        fprintf(stderr, "[mpiprof] %ld timeline event(s) dropped, raise MPIPROF_MAX_EVENTS\n", dropped);
+}
+
+/*------------------------------------------------------------*/
+/* Intercepted calls                                          */
+/*------------------------------------------------------------*/
+
+/* The drivers call plain MPI_Init; ask for the level the watchdog thread
+   needs when it is wanted */
+int MPI_Init(int *argc, char ***argv) {
+    const char *hang = getenv("MPIPROF_HANG_SECONDS");
+    int rc, provided;
+    if (hang && atof(hang) > 0) {
+        rc = PMPI_Init_thread(argc, argv, MPI_THREAD_FUNNELED, &provided);
+    } else {
+        rc = PMPI_Init(argc, argv);
+        PMPI_Query_thread(&provided);
+    }
+    prof_setup(provided);
+    return rc;
+}
+
+int MPI_Init_thread(int *argc, char ***argv, int required, int *provided) {
+    int rc = PMPI_Init_thread(argc, argv, required, provided);
+    prof_setup(*provided);
+    return rc;
+}
+
+int MPI_Finalize(void) {
+    double wall = now() - prof_t0;
+    if (hang_seconds > 0) {
+        watchdog_stop = 1;
+        pthread_join(watchdog, NULL);
+    }
+    write_summary(wall);
+    write_traffic();
+    write_trace();
+    free(events);
+    free(traffic);
+    PMPI_Comm_free_keyval(&comm_keyval);
+    PMPI_Win_free_keyval(&win_keyval);
+    PMPI_Group_free(&world_group);
+    return PMPI_Finalize();
+}
+
+int MPI_Send(const void *buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm) {
+    int peer = world_peer(dest, comm);
+    long bytes = type_bytes(type, count);
+    double t = enter(CALL_SEND, peer);
+    int rc = PMPI_Send(buf, count, type, dest, tag, comm);
+    leave(CALL_SEND, t, peer, bytes);
+    add_traffic(peer, bytes);
+    return rc;
+}
+
+int MPI_Recv(void *buf, int count, MPI_Datatype type, int source, int tag, MPI_Comm comm, MPI_Status *status) {
+    MPI_Status local;
+    if (status == MPI_STATUS_IGNORE) status = &local;
+    double t = enter(CALL_RECV, world_peer(source, comm));
+    int rc = PMPI_Recv(buf, count, type, source, tag, comm, status);
+    int received;
+    PMPI_Get_count(status, type, &received);
+    leave(CALL_RECV, t, world_peer(status->MPI_SOURCE, comm), type_bytes(type, received));
+    return rc;
+}
+
+int MPI_Isend(const void *buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm,
+              MPI_Request *request) {
+    int peer = world_peer(dest, comm);
+    long bytes = type_bytes(type, count);
+    double t = enter(CALL_ISEND, peer);
+    int rc = PMPI_Isend(buf, count, type, dest, tag, comm, request);
+    leave(CALL_ISEND, t, peer, bytes);
+    add_traffic(peer, bytes);
+    return rc;
+}
+
+int MPI_Irecv(void *buf, int count, MPI_Datatype type, int source, int tag, MPI_Comm comm,
+              MPI_Request *request) {
+    int peer = world_peer(source, comm);
+    double t = enter(CALL_IRECV, peer);
+    int rc = PMPI_Irecv(buf, count, type, source, tag, comm, request);
+    leave(CALL_IRECV, t, peer, 0);
+    return rc;
+}
+
+int MPI_Wait(MPI_Request *request, MPI_Status *status) {
+    double t = enter(CALL_WAIT, -1);
+    int rc = PMPI_Wait(request, status);
+    leave(CALL_WAIT, t, -1, 0);
+    return rc;
+}
+
+int MPI_Waitall(int count, MPI_Request requests[], MPI_Status statuses[]) {
+    double t = enter(CALL_WAITALL, -1);
+    int rc = PMPI_Waitall(count, requests, statuses);
+    leave(CALL_WAITALL, t, -1, 0);
+    return rc;
+}
+
+int MPI_Sendrecv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, int dest, int sendtag,
+                 void *recvbuf, int recvcount, MPI_Datatype recvtype, int source, int recvtag,
+                 MPI_Comm comm, MPI_Status *status) {
+    int peer = world_peer(dest, comm);
+    long bytes = type_bytes(sendtype, sendcount);
+    double t = enter(CALL_SENDRECV, peer);
+    int rc = PMPI_Sendrecv(sendbuf, sendcount, sendtype, dest, sendtag, recvbuf, recvcount, recvtype,
+                           source, recvtag, comm, status);
+    leave(CALL_SENDRECV, t, peer, bytes);
+    add_traffic(peer, bytes);
+    return rc;
+}
+
+int MPI_Sendrecv_replace(void *buf, int count, MPI_Datatype type, int dest, int sendtag, int source,
+                         int recvtag, MPI_Comm comm, MPI_Status *status) {
+    int peer = world_peer(dest, comm);
+    long bytes = type_bytes(type, count);
+    double t = enter(CALL_SENDRECV_REPLACE, peer);
+    int rc = PMPI_Sendrecv_replace(buf, count, type, dest, sendtag, source, recvtag, comm, status);
+    leave(CALL_SENDRECV_REPLACE, t, peer, bytes);
+    add_traffic(peer, bytes);
+    return rc;
+}
+
+/* Root to every other rank of comm */
+static void add_traffic_from_root(MPI_Comm comm, double bytes) {
+    int size;
+    PMPI_Comm_size(comm, &size);
+    for (int r = 0; r < size; ++r)
+        if (world_peer(r, comm) != prof_rank) add_traffic(world_peer(r, comm), bytes);
+}
+
+int MPI_Bcast(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm) {
+    int rank, peer = world_peer(root, comm);
+    long bytes = type_bytes(type, count);
+    PMPI_Comm_rank(comm, &rank);
+    double t = enter(CALL_BCAST, peer);
+    int rc = PMPI_Bcast(buf, count, type, root, comm);
+    leave(CALL_BCAST, t, peer, bytes);
+    if (rank == root) add_traffic_from_root(comm, bytes);
+    return rc;
+}
+
+int MPI_Scatter(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+                MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    int rank, peer = world_peer(root, comm);
+    PMPI_Comm_rank(comm, &rank);
+    long bytes = rank == root ? type_bytes(sendtype, sendcount) : type_bytes(recvtype, recvcount);
+    double t = enter(CALL_SCATTER, peer);
+    int rc = PMPI_Scatter(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    leave(CALL_SCATTER, t, peer, bytes);
+    if (rank == root) add_traffic_from_root(comm, bytes);
+    return rc;
+}
+
+int MPI_Scatterv(const void *sendbuf, const int sendcounts[], const int displs[], MPI_Datatype sendtype,
+                 void *recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    int rank, size, peer = world_peer(root, comm);
+    PMPI_Comm_rank(comm, &rank);
+    PMPI_Comm_size(comm, &size);
+    double t = enter(CALL_SCATTERV, peer);
+    int rc = PMPI_Scatterv(sendbuf, sendcounts, displs, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    leave(CALL_SCATTERV, t, peer, type_bytes(recvtype, recvcount));
+    if (rank == root)
+        for (int r = 0; r < size; ++r)
+            if (r != root) add_traffic(world_peer(r, comm), type_bytes(sendtype, sendcounts[r]));
+    return rc;
+}
+
+int MPI_Gather(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+               MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    int rank, peer = world_peer(root, comm);
+    PMPI_Comm_rank(comm, &rank);
+    long bytes = rank == root ? type_bytes(recvtype, recvcount) : type_bytes(sendtype, sendcount);
+    double t = enter(CALL_GATHER, peer);
+    int rc = PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    leave(CALL_GATHER, t, peer, bytes);
+    if (rank != root) add_traffic(peer, bytes);
+    return rc;
+}
+
+int MPI_Gatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf,
+                const int recvcounts[], const int displs[], MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    int rank, peer = world_peer(root, comm);
+    PMPI_Comm_rank(comm, &rank);
+    long bytes = type_bytes(sendtype, sendcount);
+    double t = enter(CALL_GATHERV, peer);
+    int rc = PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, root, comm);
+    leave(CALL_GATHERV, t, peer, bytes);
+    if (rank != root) add_traffic(peer, bytes);
+    return rc;
+}
+
+int MPI_Reduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype type, MPI_Op op, int root,
+               MPI_Comm comm) {
+    int rank, peer = world_peer(root, comm);
+    PMPI_Comm_rank(comm, &rank);
+    long bytes = type_bytes(type, count);
+    double t = enter(CALL_REDUCE, peer);
+    int rc = PMPI_Reduce(sendbuf, recvbuf, count, type, op, root, comm);
+    leave(CALL_REDUCE, t, peer, bytes);
+    if (rank != root) add_traffic(peer, bytes);
+    return rc;
+}
+
+int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm) {
+    double t = enter(CALL_ALLREDUCE, -1);
+    int rc = PMPI_Allreduce(sendbuf, recvbuf, count, type, op, comm);
+    leave(CALL_ALLREDUCE, t, -1, type_bytes(type, count));
+    return rc;
+}
+
+int MPI_Iallreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm,
+                   MPI_Request *request) {
+    double t = enter(CALL_IALLREDUCE, -1);
+    int rc = PMPI_Iallreduce(sendbuf, recvbuf, count, type, op, comm, request);
+    leave(CALL_IALLREDUCE, t, -1, type_bytes(type, count));
+    return rc;
+}
+
+int MPI_Allgather(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+                  MPI_Datatype recvtype, MPI_Comm comm) {
+    double t = enter(CALL_ALLGATHER, -1);
+    int rc = PMPI_Allgather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+    leave(CALL_ALLGATHER, t, -1, type_bytes(sendtype, sendcount));
+    return rc;
+}
+
+int MPI_Allgatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf,
+                   const int recvcounts[], const int displs[], MPI_Datatype recvtype, MPI_Comm comm) {
+    double t = enter(CALL_ALLGATHERV, -1);
+    int rc = PMPI_Allgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, comm);
+    leave(CALL_ALLGATHERV, t, -1, type_bytes(sendtype, sendcount));
+    return rc;
+}
+
+int MPI_Barrier(MPI_Comm comm) {
+    double t = enter(CALL_BARRIER, -1);
+    int rc = PMPI_Barrier(comm);
+    leave(CALL_BARRIER, t, -1, 0);
+    return rc;
+}
+
+int MPI_Test(MPI_Request *request, int *flag, MPI_Status *status) {
+    double t = enter(CALL_TEST, -1);
+    int rc = PMPI_Test(request, flag, status);
+    leave(CALL_TEST, t, -1, 0);
+    return rc;
+}
+
+int MPI_Iprobe(int source, int tag, MPI_Comm comm, int *flag, MPI_Status *status) {
+    int peer = world_peer(source, comm);
+    double t = enter(CALL_IPROBE, peer);
+    int rc = PMPI_Iprobe(source, tag, comm, flag, status);
+    leave(CALL_IPROBE, t, peer, 0);
+    return rc;
+}
+
+int MPI_Ibarrier(MPI_Comm comm, MPI_Request *request) {
+    double t = enter(CALL_IBARRIER, -1);
+    int rc = PMPI_Ibarrier(comm, request);
+    leave(CALL_IBARRIER, t, -1, 0);
+    return rc;
+}
+
+int MPI_Ibcast(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm, MPI_Request *request) {
+    int rank, peer = world_peer(root, comm);
+    long bytes = type_bytes(type, count);
+    PMPI_Comm_rank(comm, &rank);
+    double t = enter(CALL_IBCAST, peer);
+    int rc = PMPI_Ibcast(buf, count, type, root, comm, request);
+    leave(CALL_IBCAST, t, peer, bytes);
+    if (rank == root) add_traffic_from_root(comm, bytes);
+    return rc;
+}
+
+int MPI_Accumulate(const void *origin, int origin_count, MPI_Datatype origin_type, int target,
+                   MPI_Aint target_disp, int target_count, MPI_Datatype target_type, MPI_Op op, MPI_Win win) {
+    int peer = win_peer(target, win);
+    long bytes = type_bytes(origin_type, origin_count);
+    double t = enter(CALL_ACCUMULATE, peer);
+    int rc = PMPI_Accumulate(origin, origin_count, origin_type, target, target_disp, target_count, target_type,
+                             op, win);
+    leave(CALL_ACCUMULATE, t, peer, bytes);
+    add_traffic(peer, bytes);
+    return rc;
+}
+
+int MPI_Fetch_and_op(const void *origin, void *result, MPI_Datatype type, int target, MPI_Aint target_disp,
+                     MPI_Op op, MPI_Win win) {
+    int peer = win_peer(target, win);
+    long bytes = type_bytes(type, 1);
+    double t = enter(CALL_FETCH_AND_OP, peer);
+    int rc = PMPI_Fetch_and_op(origin, result, type, target, target_disp, op, win);
+    leave(CALL_FETCH_AND_OP, t, peer, bytes);
+    add_traffic(peer, bytes);
+    return rc;
+}
+
+int MPI_Win_flush(int target, MPI_Win win) {
+    int peer = win_peer(target, win);
+    double t = enter(CALL_WIN_FLUSH, peer);
+    int rc = PMPI_Win_flush(target, win);
+    leave(CALL_WIN_FLUSH, t, peer, 0);
+    return rc;
+}
@@ -0,0 +1,328 @@
+/*
+ * Alpha-beta-gamma performance model of the matrix drivers (MPI / MPICH)
+ * -----------------------------------------------------------------------
+ *  - Purpose: Choose cluster sizes and spot anomalous runs without running
+ *    every (N, P) combination five times.
+ *  - Features:
+ *      • Calibration on the current cluster with short probes:
+ *          alpha  latency, 8-byte ping-pong between rank 0 and rank 1
+ *          beta   inverse bandwidth (s/byte), least-squares fit of the
+ *                 same ping-pong over message sizes up to 1 MiB
+ *          gamma  seconds per arithmetic op of the i-k-j kernel used by
+ *                 block rows, Cannon and Fox and of the i-j-k kernel used
+ *                 by Strassen, plus seconds per element of add/sub/split;
+ *                 the slowest rank's value is kept
+ *      • Predicted time of the timed region of block rows, Cannon, Fox and
+ *        Strassen and parallel efficiency for every (N, P) requested
+ *      • Comparison with measured runs read from a CSV file, flagging the
+ *        runs outside the tolerance
+ *
+ *  Build & run examples
+ *  --------------------
+ *      mpicc -o perf_model perf_model.c -lm      # same flags as the drivers
+ *      mpirun -np 2 -ppn 1 ./perf_model                     # ranks on 2 nodes
+ *      mpirun -np 2 -ppn 1 ./perf_model -n 1024,4096 -p 4,16,64 measured_runs.csv
+ *      ./perf_model -a 60e-6 -b 1e-8 -g 1e-9 -G 3e-9 -c 2e-9 measured_runs.csv
+ *
+ *  Measured runs CSV: "<algorithm>,<N>,<P>,<seconds>" per line, algorithm
+ *  one of block_rows, cannon, fox, strassen; '#' starts a comment.
+ *
+ *  Notes
+ *  -----
+ *      • gamma is only as good as the match between the probe's and the
+ *        drivers' compiler flags: the Dockerfile builds the drivers without
+ *        -O, so perf_model is built that way too. Rebuild both together
+ *        (or pass -g/-G/-c) when changing the optimisation level.
+ *      • The models follow the communication the code actually does, e.g.
+ *        foxs_algorithm.c shifts A and B like Cannon, so both share the
+ *        Cannon model.
+ *      • Strassen is modelled as the intended one-level distribution of the
+ *        seven products; the current code nests its collectives inside the
+ *        recursion and fails for P > 1 (see readme.txt).
+ */
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#define MAX_LIST 16
+#define PROBE_BLOCK 256
+#define STRASSEN_THRESHOLD 256
+
+typedef struct {
+    double alpha, beta;        /* s, s/byte                              */
+    double gamma_ikj;          /* s per op, i-k-j kernel                 */
+    double gamma_ijk;          /* s per op, i-j-k kernel (Strassen)      */
+    double gamma_add;          /* s per element of add/sub/split         */
+} Model;
+
+enum { ALG_BLOCK_ROWS, ALG_CANNON, ALG_FOX, ALG_STRASSEN, NALGS };
+static const char *alg_names[NALGS] = {"block_rows", "cannon", "fox", "strassen"};
+
+/*------------------------------------------------------------*/
+/* Calibration probes                                         */
+/*------------------------------------------------------------*/
+
+/* Fit t(m) = alpha + beta * m from ping-pong half round trips */
+static void probe_network(Model *m, int rank) {
+    static const int sizes[] = {8, 1024, 16384, 131072, 1048576};
+    const int nsizes = (int)(sizeof(sizes) / sizeof(sizes[0]));
+    char *buf = calloc(sizes[nsizes - 1], 1);
+    double x[8], y[8];
+
+    for (int s = 0; s < nsizes; ++s) {
+        int reps = sizes[s] >= 131072 ? 10 : 50;
+        double best = 1e30;
+        for (int r = 0; r < reps + 2; ++r) {
+            MPI_Barrier(MPI_COMM_WORLD);
+            double t0 = MPI_Wtime();
+            if (rank == 0) {
+                MPI_Send(buf, sizes[s], MPI_BYTE, 1, 0, MPI_COMM_WORLD);
+                MPI_Recv(buf, sizes[s], MPI_BYTE, 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            } else if (rank == 1) {
+                MPI_Recv(buf, sizes[s], MPI_BYTE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                MPI_Send(buf, sizes[s], MPI_BYTE, 0, 0, MPI_COMM_WORLD);
+            }
+            double t = (MPI_Wtime() - t0) / 2.0;
+            if (r >= 2 && t < best) best = t;   /* first two are warm-up */
+        }
+        x[s] = sizes[s];
+        y[s] = best;
+    }
+    free(buf);
+
+    /* Latency from the smallest message, bandwidth from a least-squares
+       fit of the remaining time through the origin */
+    double smm = 0, smt = 0;
+    m->alpha = y[0];
+    for (int s = 1; s < nsizes; ++s) {
+        smm += x[s] * x[s];
+        smt += x[s] * (y[s] - m->alpha);
+    }
+    m->beta = smt > 0 ? smt / smm : 0.0;
+    MPI_Bcast(&m->alpha, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&m->beta, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+}
+
+static void kernel_ikj(const int *A, const int *B, int *C, int n) {
+    for (int i = 0; i < n; ++i)
+        for (int k = 0; k < n; ++k)
+            for (int j = 0; j < n; ++j)
+                C[i * n + j] += A[i * n + k] * B[k * n + j];
+}
+
+static void kernel_ijk(const int *A, const int *B, int *C, int n) {
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+            for (int k = 0; k < n; ++k)
+                C[i * n + j] += A[i * n + k] * B[k * n + j];
+}
+
+static void probe_compute(Model *m) {
+    const int n = PROBE_BLOCK;
+    size_t elems = (size_t)n * n;
+    int *A = malloc(elems * sizeof(int)), *B = malloc(elems * sizeof(int)), *C = calloc(elems, sizeof(int));
+    for (size_t i = 0; i < elems; ++i) A[i] = (int)(i % 10) + 1, B[i] = (int)(i % 7) + 1;
+
+    double t0 = MPI_Wtime();
+    kernel_ikj(A, B, C, n);
+    m->gamma_ikj = (MPI_Wtime() - t0) / (2.0 * n * n * n);
+
+    t0 = MPI_Wtime();
+    kernel_ijk(A, B, C, n);
+    m->gamma_ijk = (MPI_Wtime() - t0) / (2.0 * n * n * n);
+
+    t0 = MPI_Wtime();
+    for (int rep = 0; rep < 16; ++rep)
+        for (size_t i = 0; i < elems; ++i) C[i] = A[i] + B[i];
+    m->gamma_add = (MPI_Wtime() - t0) / (16.0 * elems);
+
+    volatile int sink = C[elems - 1];
+    (void)sink;
+    free(A);
+    free(B);
+    free(C);
+
+    /* The run is as fast as its slowest rank */
+    MPI_Allreduce(MPI_IN_PLACE, &m->gamma_ikj, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &m->gamma_ijk, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &m->gamma_add, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+}
+
+/*------------------------------------------------------------*/
+/* Models of the timed regions                                */
+/*------------------------------------------------------------*/
+
+static double log2_ceil(int p) {
+    return p > 1 ? ceil(log2((double)p)) : 0.0;
+}
+
+/* Sequential Strassen below the top level, as strassen() recurses */
+static double strassen_seq(const Model *m, double n) {
+    if (n <= STRASSEN_THRESHOLD) return 2.0 * n * n * n * m->gamma_ijk;
+    double h2 = (n / 2) * (n / 2);
+    /* 8 splits, 10 operand adds/subs, 8 adds to combine */
+    return 26.0 * h2 * m->gamma_add + 7.0 * strassen_seq(m, n / 2);
+}
+
+/* Predicted seconds of the timed region, or -1 if (n, p) is not valid */
+static double predict(const Model *m, int alg, int n, int p) {
+    double nn = n;
+    switch (alg) {
+        case ALG_BLOCK_ROWS: {
+            /* Only the local multiplication is timed; the even Scatterv
+               split gives the first N % P ranks one row more */
+            double rows = (n + p - 1) / p;
+            return 2.0 * rows * nn * nn * m->gamma_ikj;
+        }
+        case ALG_CANNON:
+        case ALG_FOX: {
+            int q = (int)sqrt(p);
+            if (q * q != p || n % q != 0) return -1;
+            double b = nn / q;
+            double shift = m->alpha + 4.0 * b * b * m->beta;
+            return q * (2.0 * b * b * b * m->gamma_ikj + 2.0 * shift);
+        }
+        case ALG_STRASSEN: {
+            if (n % 2 != 0) return -1;
+            double h = nn / 2, h2 = h * h;
+            int per_rank = (7 + p - 1) / p;
+            double compute = 8.0 * h2 * m->gamma_add                          /* splits   */
+                             + per_rank * (2.0 * h2 * m->gamma_add + strassen_seq(m, h));
+            double reduce = 7.0 * log2_ceil(p) * (m->alpha + 4.0 * h2 * m->beta + h2 * m->gamma_add);
+            return compute + reduce + 8.0 * h2 * m->gamma_add;                /* combine  */
+        }
+    }
+    return -1;
+}
+
+/*------------------------------------------------------------*/
+
+static int parse_list(const char *arg, int *list) {
+    int count = 0;
+    char *copy = strdup(arg), *save = NULL;
+    for (char *tok = strtok_r(copy, ",", &save); tok && count < MAX_LIST; tok = strtok_r(NULL, ",", &save))
+        if (atoi(tok) > 0) list[count++] = atoi(tok);
+    free(copy);
+    return count;
+}
+
+static int alg_from_name(const char *name) {
+    for (int a = 0; a < NALGS; ++a)
+        if (strcmp(name, alg_names[a]) == 0) return a;
+    return -1;
+}
+
+static void print_predictions(const Model *m, const int *ns, int nn, const int *ps, int np) {
+    printf("\nPredicted time of the timed region (s) and parallel efficiency\n");
+    printf("%-11s %6s %5s %12s %8s\n", "algorithm", "N", "P", "time (s)", "eff.");
+    for (int a = 0; a < NALGS; ++a)
+        for (int i = 0; i < nn; ++i) {
+            double t1 = predict(m, a, ns[i], 1);
+            for (int j = 0; j < np; ++j) {
+                double t = predict(m, a, ns[i], ps[j]);
+                if (t < 0) continue;
+                printf("%-11s %6d %5d %12.6f %7.1f%%\n", alg_names[a], ns[i], ps[j], t,
+                       100.0 * t1 / (ps[j] * t));
+            }
+        }
+}
+
+static void compare_measured(const Model *m, const char *path, double tolerance) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Error: cannot read measured runs \"%s\".\n", path);
+        return;
+    }
+    printf("\nMeasured runs against the model (anomalous if off by more than x%.2f)\n", tolerance);
+    printf("%-11s %6s %5s %12s %12s %8s\n", "algorithm", "N", "P", "measured", "predicted", "ratio");
+    char line[256], name[64];
+    int anomalies = 0, runs = 0;
+    while (fgets(line, sizeof(line), f)) {
+        int n, p;
+        double seconds;
+        if (line[0] == '#' || sscanf(line, " %63[^,],%d,%d,%lf", name, &n, &p, &seconds) != 4) continue;
+        int alg = alg_from_name(name);
+        double t = alg >= 0 ? predict(m, alg, n, p) : -1;
+        if (t <= 0) {
+            printf("%-11s %6d %5d %12.6f %12s\n", name, n, p, seconds, "n/a");
+            continue;
+        }
+        double ratio = seconds / t;
+        int anomalous = ratio > tolerance || ratio < 1.0 / tolerance;
+        printf("%-11s %6d %5d %12.6f %12.6f %8.2f%s\n", name, n, p, seconds, t, ratio,
+               anomalous ? "  ANOMALY" : "");
+        anomalies += anomalous;
+        runs++;
+    }
+    fclose(f);
+    printf("%d of %d run(s) outside the tolerance\n", anomalies, runs);
+}
+
+int main(int argc, char *argv[]) {
+    MPI_Init(&argc, &argv);
+
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    Model m = {-1, -1, -1, -1, -1};
+    int ns[MAX_LIST] = {1024, 2048, 4096}, nn = 3;
+    int ps[MAX_LIST] = {1, 4, 8, 16, 64}, np = 5;
+    double tolerance = 1.5;
+    int opt;
+    while ((opt = getopt(argc, argv, "a:b:g:G:c:n:p:t:")) != -1) {
+        switch (opt) {
+            case 'a': m.alpha = atof(optarg); break;
+            case 'b': m.beta = atof(optarg); break;
+            case 'g': m.gamma_ikj = atof(optarg); break;
+            case 'G': m.gamma_ijk = atof(optarg); break;
+            case 'c': m.gamma_add = atof(optarg); break;
+            case 'n': nn = parse_list(optarg, ns); break;
+            case 'p': np = parse_list(optarg, ps); break;
+            case 't': tolerance = atof(optarg); break;
+            default:
+                if (rank == 0)
+                    fprintf(stderr, "Usage: %s [-a alpha] [-b beta] [-g gamma_ikj] [-G gamma_ijk] [-c gamma_add]\n"
+                                    "          [-n N,...] [-p P,...] [-t tolerance] [measured.csv]\n", argv[0]);
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+    }
+
+    int need_network = m.alpha < 0 || m.beta < 0;
+    if (need_network && size < 2) {
+        if (rank == 0) fprintf(stderr, "Error: measuring alpha and beta needs 2 processes (or pass -a and -b).\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    if (need_network) {
+        Model probed;
+        probe_network(&probed, rank);
+        if (m.alpha < 0) m.alpha = probed.alpha;
+        if (m.beta < 0) m.beta = probed.beta;
+    }
+    if (m.gamma_ikj < 0 || m.gamma_ijk < 0 || m.gamma_add < 0) {
+        Model probed;
+        probe_compute(&probed);
+        if (m.gamma_ikj < 0) m.gamma_ikj = probed.gamma_ikj;
+        if (m.gamma_ijk < 0) m.gamma_ijk = probed.gamma_ijk;
+        if (m.gamma_add < 0) m.gamma_add = probed.gamma_add;
+    }
+
+    if (rank == 0) {
+        printf("Model parameters%s\n", need_network ? " (measured between rank 0 and rank 1)" : "");
+        printf("  alpha     = %.3e s        (latency)\n", m.alpha);
+        printf("  beta      = %.3e s/byte   (%.1f MB/s)\n", m.beta, m.beta > 0 ? 1e-6 / m.beta : 0.0);
+        printf("  gamma_ikj = %.3e s/op     (%.3f GOP/s, block rows / Cannon / Fox kernel)\n", m.gamma_ikj,
+               1e-9 / m.gamma_ikj);
+        printf("  gamma_ijk = %.3e s/op     (%.3f GOP/s, Strassen kernel)\n", m.gamma_ijk, 1e-9 / m.gamma_ijk);
+        printf("  gamma_add = %.3e s/elem   (Strassen add/sub/split)\n", m.gamma_add);
+        print_predictions(&m, ns, nn, ps, np);
+        if (optind < argc) compare_measured(&m, argv[optind], tolerance);
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,227 @@
+/*
+ * Hardware counter instrumentation of program regions, see perf_regions.h
+ */
+
+#include "perf_regions.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+enum { CTR_CYCLES, CTR_INSTRUCTIONS, CTR_LLC_MISSES, CTR_DTLB_MISSES, CTR_VECTOR, NCOUNTERS };
+
+static const char *region_names[PR_NREGIONS] = {"compute", "copy", "comm"};
+
+typedef struct {
+    double time;
+    double ops;
+    double counters[NCOUNTERS];
+    int depth;                      /* nested begin/end of the same region */
+    double start_time;
+    uint64_t start[NCOUNTERS];
+} Region;
+
+static Region regions[PR_NREGIONS];
+static int fds[NCOUNTERS] = {-1, -1, -1, -1, -1};
+static int slot[NCOUNTERS];         /* position of each counter in the group read */
+static int ncounters_open;
+static int group_fd = -1;
+static int initialized;
+
+/*------------------------------------------------------------*/
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int open_counter(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group_fd < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+static void add_counter(int id, uint32_t type, uint64_t config) {
+    int fd = open_counter(type, config);
+    if (fd < 0) return;
+    if (group_fd < 0) group_fd = fd;
+    fds[id] = fd;
+    slot[id] = ncounters_open++;
+}
+
+/* Read the whole group at once; values[] indexed by counter id */
+static void read_counters(uint64_t *values) {
+    uint64_t buf[1 + NCOUNTERS];
+    memset(values, 0, NCOUNTERS * sizeof(uint64_t));
+    if (group_fd < 0 || read(group_fd, buf, sizeof(buf)) <= 0) return;
+    for (int c = 0; c < NCOUNTERS; ++c)
+        if (fds[c] >= 0) values[c] = buf[1 + slot[c]];
+}
+
+void perf_regions_init(void) {
+    if (initialized) return;
+    initialized = 1;
+    add_counter(CTR_CYCLES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    add_counter(CTR_INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    add_counter(CTR_LLC_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    add_counter(CTR_DTLB_MISSES, PERF_TYPE_HW_CACHE,
+                PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    const char *vec = getenv("PERF_REGIONS_VEC_EVENT");
+    if (vec) add_counter(CTR_VECTOR, PERF_TYPE_RAW, strtoull(vec, NULL, 16));
+    if (group_fd >= 0) {
+        ioctl(group_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(group_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+void perf_region_begin(int region) {
+    Region *r = &regions[region];
+    if (r->depth++ > 0) return;
+    read_counters(r->start);
+    r->start_time = now();
+}
+
+void perf_region_end(int region) {
+    Region *r = &regions[region];
+    if (--r->depth > 0) return;
+    double t = now();
+    uint64_t values[NCOUNTERS];
+    read_counters(values);
+    r->time += t - r->start_time;
+    for (int c = 0; c < NCOUNTERS; ++c) r->counters[c] += (double)(values[c] - r->start[c]);
+}
+
+void perf_region_add_ops(int region, double ops) {
+    regions[region].ops += ops;
+}
+
+/*------------------------------------------------------------*/
+
+/* Copy bandwidth of this rank in GB/s (bytes read + written) */
+static double probe_bandwidth(void) {
+    const size_t elems = (size_t)2 << 20;   /* 2 x 16 MiB of doubles */
+    double *a = malloc(elems * sizeof(double)), *b = malloc(elems * sizeof(double));
+    if (!a || !b) {
+        free(a);
+        free(b);
+        return 0.0;
+    }
+    for (size_t i = 0; i < elems; ++i) a[i] = (double)i, b[i] = 0.0;
+    double best = 1e30;
+    for (int rep = 0; rep < 3; ++rep) {
+        double t0 = now();
+        memcpy(b, a, elems * sizeof(double));
+        double t = now() - t0;
+        if (t < best) best = t;
+    }
+    volatile double sink = b[elems - 1];
+    (void)sink;
+    free(a);
+    free(b);
+    return 2.0 * elems * sizeof(double) / best / 1e9;
+}
+
+void perf_regions_report(MPI_Comm comm, const char *title) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    /* Per rank row: time, ops, counters per region */
+    enum { FIELDS = 2 + NCOUNTERS };
+    double local[PR_NREGIONS * FIELDS], sum[PR_NREGIONS * FIELDS], max[PR_NREGIONS * FIELDS];
+    for (int r = 0; r < PR_NREGIONS; ++r) {
+        local[r * FIELDS + 0] = regions[r].time;
+        local[r * FIELDS + 1] = regions[r].ops;
+        memcpy(&local[r * FIELDS + 2], regions[r].counters, sizeof(regions[r].counters));
+    }
+    MPI_Reduce(local, sum, PR_NREGIONS * FIELDS, MPI_DOUBLE, MPI_SUM, 0, comm);
+    MPI_Reduce(local, max, PR_NREGIONS * FIELDS, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+    int have[NCOUNTERS];
+    for (int c = 0; c < NCOUNTERS; ++c) have[c] = fds[c] >= 0;
+    MPI_Allreduce(MPI_IN_PLACE, have, NCOUNTERS, MPI_INT, MPI_MIN, comm);
+
+    double peak_gops = getenv("PERF_PEAK_GOPS") ? atof(getenv("PERF_PEAK_GOPS")) : 0.0;
+    double peak_gbs = getenv("PERF_PEAK_GBS") ? atof(getenv("PERF_PEAK_GBS")) : 0.0;
+    if (peak_gbs <= 0.0) {
+        double bw = probe_bandwidth();
+        MPI_Allreduce(&bw, &peak_gbs, 1, MPI_DOUBLE, MPI_MIN, comm);
+    }
+
+    int per_rank = getenv("PERF_REGIONS_PER_RANK") && atoi(getenv("PERF_REGIONS_PER_RANK"));
+    double *rows = NULL;
+    if (per_rank && rank == 0) rows = malloc((size_t)size * PR_NREGIONS * FIELDS * sizeof(double));
+    if (per_rank) MPI_Gather(local, PR_NREGIONS * FIELDS, MPI_DOUBLE, rows, PR_NREGIONS * FIELDS, MPI_DOUBLE, 0, comm);
+
+    if (rank != 0) return;
+
+    printf("Performance counters: %s (%d process(es))\n", title, size);
+    if (!have[CTR_CYCLES]) printf("  (hardware counters unavailable: perf_event_open not permitted)\n");
+    printf("  %-8s %10s %8s %6s %11s %10s %12s %9s %11s %9s\n", "region", "max t (s)", "GOP/s", "IPC",
+           "LLC miss/ki", "DRAM GB/s", "dTLB miss/ki", "vec ops", "AI (op/B)", "roofline");
+    for (int r = 0; r < PR_NREGIONS; ++r) {
+        const double *s = &sum[r * FIELDS], *m = &max[r * FIELDS];
+        if (m[0] <= 0.0) continue;
+        double gops = s[1] / m[0] / 1e9;
+        double cycles = s[2 + CTR_CYCLES], instr = s[2 + CTR_INSTRUCTIONS];
+        double llc = s[2 + CTR_LLC_MISSES], dram_bytes = llc * 64.0;
+
+        printf("  %-8s %10.6f %8.3f", region_names[r], m[0], gops);
+        if (have[CTR_CYCLES] && have[CTR_INSTRUCTIONS] && cycles > 0)
+            printf(" %6.2f", instr / cycles);
+        else
+            printf(" %6s", "n/a");
+        if (have[CTR_LLC_MISSES] && instr > 0)
+            printf(" %11.3f %10.3f", 1000.0 * llc / instr, dram_bytes / m[0] / 1e9);
+        else
+            printf(" %11s %10s", "n/a", "n/a");
+        if (have[CTR_DTLB_MISSES] && instr > 0)
+            printf(" %12.3f", 1000.0 * s[2 + CTR_DTLB_MISSES] / instr);
+        else
+            printf(" %12s", "n/a");
+        if (have[CTR_VECTOR])
+            printf(" %9.3g", s[2 + CTR_VECTOR]);
+        else
+            printf(" %9s", "n/a");
+        if (have[CTR_LLC_MISSES] && dram_bytes > 0 && s[1] > 0) {
+            /* Roofline of the whole job: size ranks of this machine */
+            double ai = s[1] / dram_bytes;
+            double bound = ai * peak_gbs * size;
+            if (peak_gops > 0 && peak_gops * size < bound) bound = peak_gops * size;
+            printf(" %11.3f %8.1f%%", ai, 100.0 * gops / bound);
+        } else {
+            printf(" %11s %9s", "n/a", "n/a");
+        }
+        printf("\n");
+    }
+    printf("  roofline: %.2f GB/s per rank%s", peak_gbs, getenv("PERF_PEAK_GBS") ? "" : " (copy probe)");
+    if (peak_gops > 0) printf(", %.2f GOP/s per rank", peak_gops);
+    printf("; last column is achieved / attainable GOP/s\n");
+
+    if (per_rank) {
+        printf("  %-6s %-8s %10s %14s %14s %14s\n", "rank", "region", "time (s)", "cycles", "instructions",
+               "LLC misses");
+        for (int p = 0; p < size; ++p)
+            for (int r = 0; r < PR_NREGIONS; ++r) {
+                const double *v = &rows[(p * PR_NREGIONS + r) * FIELDS];
+                if (v[0] <= 0.0) continue;
+                printf("  %-6d %-8s %10.6f %14.0f %14.0f %14.0f\n", p, region_names[r], v[0],
+                       v[2 + CTR_CYCLES], v[2 + CTR_INSTRUCTIONS], v[2 + CTR_LLC_MISSES]);
+            }
+        free(rows);
+    }
+}
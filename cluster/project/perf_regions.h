@@ -0,0 +1,65 @@
+/*
+ * Hardware counter instrumentation of program regions (perf_event_open)
+ * ----------------------------------------------------------------------
+ *  - Purpose: Tell whether a phase of a driver is compute-bound or
+ *    memory-bound instead of only timing the whole loop.
+ *  - Features:
+ *      • Begin/end markers for the compute, copy and communication phases
+ *      • Per rank and region: time, cycles, instructions, LLC misses, dTLB
+ *        load misses and an optional vector-instruction raw event
+ *      • Report aggregated across ranks with IPC, estimated DRAM traffic,
+ *        achieved GOP/s and the roofline bound of the machine
+ *
+ *  Build examples
+ *  --------------
+ *      mpicc -O3 -DPERF_REGIONS -o cannons_algorithm cannons_algorithm.c compressed_transport.c matrix_alloc.c perf_regions.c -lm
+ *      mpicc -O3 -o cannons_algorithm cannons_algorithm.c compressed_transport.c matrix_alloc.c -lm   # markers compile to nothing
+ *
+ *  Environment
+ *  -----------
+ *      PERF_REGIONS_VEC_EVENT  raw PMU event counting vector instructions, in
+ *                              hex (e.g. 0x01c7 FP_ARITH scalar double on
+ *                              Intel); not counted when unset
+ *      PERF_PEAK_GOPS          peak arithmetic throughput per rank (GOP/s)
+ *      PERF_PEAK_GBS           peak memory bandwidth per rank (GB/s); a
+ *                              short copy probe measures it when unset
+ *      PERF_REGIONS_PER_RANK   1 prints one line per rank and region
+ *
+ *  Notes
+ *  -----
+ *      • perf_event_open is blocked by Docker's default seccomp profile;
+ *        run the containers with CAP_PERFMON (or CAP_SYS_ADMIN) to get the
+ *        counters. Without them only time and GOP/s are reported.
+ *      • DRAM traffic is estimated as LLC misses x 64 bytes.
+ *      • The drivers multiply integers, so the arithmetic rate is reported
+ *        in GOP/s (one multiply-add counts as two operations).
+ */
+
+#ifndef PERF_REGIONS_H
+#define PERF_REGIONS_H
+
+#include <mpi.h>
+
+enum { PR_COMPUTE, PR_COPY, PR_COMM, PR_NREGIONS };
+
+void perf_regions_init(void);
+void perf_region_begin(int region);
+void perf_region_end(int region);
+void perf_region_add_ops(int region, double ops);
+void perf_regions_report(MPI_Comm comm, const char *title);
+
+#ifdef PERF_REGIONS
+#define PR_INIT() perf_regions_init()
+#define PR_BEGIN(region) perf_region_begin(region)
+#define PR_END(region) perf_region_end(region)
+#define PR_OPS(region, ops) perf_region_add_ops(region, ops)
+#define PR_REPORT(comm, title) perf_regions_report(comm, title)
+#else
+#define PR_INIT() ((void)0)
+#define PR_BEGIN(region) ((void)0)
+#define PR_END(region) ((void)0)
+#define PR_OPS(region, ops) ((void)0)
+#define PR_REPORT(comm, title) ((void)0)
+#endif
+
+#endif
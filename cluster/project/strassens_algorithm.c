@@ -6,6 +6,9 @@
 #include <math.h>
 #include <time.h>
 
+#include "perf_regions.h"
+#include "matrix_alloc.h"
+
 #define MATRIX_SIZE 1024
 #define MAX_VAL 10
 #define MIN_VAL 1
@@ -17,25 +20,36 @@ void fill_random(int *m, int n) {
 }
 
 void classic_multiply(int *A, int *B, int *C, int n) {
+    PR_BEGIN(PR_COMPUTE);
     for (int i = 0; i < n; ++i)
         for (int j = 0; j < n; ++j)
             for (int k = 0; k < n; ++k)
                 C[i * n + j] += A[i * n + k] * B[k * n + j];
+    PR_END(PR_COMPUTE);
+    PR_OPS(PR_COMPUTE, 2.0 * n * n * n);
 }
 
 void add_mat(int *A, int *B, int *C, int n) {
+    PR_BEGIN(PR_COPY);
     for (int i = 0; i < n * n; ++i) C[i] = A[i] + B[i];
+    PR_END(PR_COPY);
+    PR_OPS(PR_COPY, (double)n * n);
 }
 
 void sub_mat(int *A, int *B, int *C, int n) {
+    PR_BEGIN(PR_COPY);
     for (int i = 0; i < n * n; ++i) C[i] = A[i] - B[i];
+    PR_END(PR_COPY);
+    PR_OPS(PR_COPY, (double)n * n);
 }
 
 void split(int *M, int *S, int n, int r, int c) {
     int half = n / 2;
+    PR_BEGIN(PR_COPY);
     for (int i = 0; i < half; ++i)
         for (int j = 0; j < half; ++j)
             S[i * half + j] = M[(i + r) * n + (j + c)];
+    PR_END(PR_COPY);
 }
 
 void strassen(int *A, int *B, int *C, int n) {
@@ -47,8 +61,8 @@ void strassen(int *A, int *B, int *C, int n) {
     int half = n / 2;
     size_t sz = half * half * sizeof(int);
 
-    int *A11 = malloc(sz), *A12 = malloc(sz), *A21 = malloc(sz), *A22 = malloc(sz);
-    int *B11 = malloc(sz), *B12 = malloc(sz), *B21 = malloc(sz), *B22 = malloc(sz);
+    int *A11 = matrix_alloc(sz), *A12 = matrix_alloc(sz), *A21 = matrix_alloc(sz), *A22 = matrix_alloc(sz);
+    int *B11 = matrix_alloc(sz), *B12 = matrix_alloc(sz), *B21 = matrix_alloc(sz), *B22 = matrix_alloc(sz);
 
     split(A, A11, n, 0, 0);
     split(A, A12, n, 0, half);
@@ -61,13 +75,13 @@ void strassen(int *A, int *B, int *C, int n) {
 
     int *local_M[7];
     for (int i = 0; i < 7; ++i)
-        local_M[i] = calloc(half * half, sizeof(int));
+        local_M[i] = matrix_alloc(half * half * sizeof(int));
 
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
-    int *T1 = malloc(sz), *T2 = malloc(sz);
+    int *T1 = matrix_alloc(sz), *T2 = matrix_alloc(sz);
 
     for (int i = rank; i < 7; i += size) {
         switch (i) {
@@ -107,11 +121,13 @@ void strassen(int *A, int *B, int *C, int n) {
 
     int *M[7];
     for (int i = 0; i < 7; ++i)
-        M[i] = (rank == 0) ? calloc(half * half, sizeof(int)) : NULL;
+        M[i] = (rank == 0) ? matrix_alloc(half * half * sizeof(int)) : NULL;
 
+    PR_BEGIN(PR_COMM);
     for (int i = 0; i < 7; ++i) {
         MPI_Reduce(local_M[i], M[i], half * half, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
     }
+    PR_END(PR_COMM);
 
     if (rank == 0) {
         int *C11 = C;
@@ -131,25 +147,26 @@ void strassen(int *A, int *B, int *C, int n) {
         add_mat(T1, M[5], C22, half);
     }
 
-    free(A11); free(A12); free(A21); free(A22);
-    free(B11); free(B12); free(B21); free(B22);
+    matrix_free(A11); matrix_free(A12); matrix_free(A21); matrix_free(A22);
+    matrix_free(B11); matrix_free(B12); matrix_free(B21); matrix_free(B22);
     for (int i = 0; i < 7; ++i) {
-        free(local_M[i]);
-        if (rank == 0) free(M[i]);
+        matrix_free(local_M[i]);
+        if (rank == 0) matrix_free(M[i]);
     }
-    free(T1); free(T2);
+    matrix_free(T1); matrix_free(T2);
 }
 
 int main(int argc, char **argv) {
     MPI_Init(&argc, &argv);
+    PR_INIT();
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
     const int n = MATRIX_SIZE;
-    int *A = malloc(n * n * sizeof(int));
-    int *B = malloc(n * n * sizeof(int));
-    int *C = calloc(n * n, sizeof(int));
+    int *A = matrix_alloc(n * n * sizeof(int));
+    int *B = matrix_alloc(n * n * sizeof(int));
+    int *C = matrix_alloc(n * n * sizeof(int));
 
     if (rank == 0) {
         srand((unsigned)time(NULL));
@@ -157,8 +174,10 @@ int main(int argc, char **argv) {
         fill_random(B, n * n);
     }
 
+    PR_BEGIN(PR_COMM);
     MPI_Bcast(A, n * n, MPI_INT, 0, MPI_COMM_WORLD);
     MPI_Bcast(B, n * n, MPI_INT, 0, MPI_COMM_WORLD);
+    PR_END(PR_COMM);
 
     MPI_Barrier(MPI_COMM_WORLD);
     double t0 = MPI_Wtime();
@@ -170,7 +189,10 @@ int main(int argc, char **argv) {
         printf("Strassen distribuido terminó en %.6f s\n", elapsed);
     }
 
-    free(A); free(B); free(C);
+    PR_REPORT(MPI_COMM_WORLD, "Strassen");
+    matrix_alloc_report(MPI_COMM_WORLD, "Strassen");
+
+    matrix_free(A); matrix_free(B); matrix_free(C);
     MPI_Finalize();
     return 0;
 }
@@ -0,0 +1,118 @@
+/*
+ * Decentralized work stealing over a range of work units, see
+ * work_stealing.h
+ *
+ * Messages (on the private communicator):
+ *     TAG_REQ    thief -> victim, empty
+ *     TAG_REPLY  victim -> thief, the granted range {lo, hi}, empty if lo == hi
+ */
+
+#include "work_stealing.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TAG_REQ 1
+#define TAG_REPLY 2
+
+void ws_init(WorkSteal *ws, MPI_Comm comm, long lo, long hi, long total, long min_steal) {
+    memset(ws, 0, sizeof(*ws));
+    MPI_Comm_dup(comm, &ws->comm);
+    MPI_Comm_rank(ws->comm, &ws->rank);
+    MPI_Comm_size(ws->comm, &ws->size);
+    ws->lo = lo;
+    ws->hi = hi;
+    ws->total = total;
+    ws->min_steal = min_steal > 0 ? min_steal : 1;
+    ws->seed = (unsigned)time(NULL) + (unsigned)ws->rank;
+
+    MPI_Win_allocate(ws->rank == 0 ? sizeof(long) : 0, sizeof(long), MPI_INFO_NULL, ws->comm, &ws->counter,
+                     &ws->win);
+    if (ws->rank == 0) *ws->counter = 0;
+    /* Nobody reads the counter before rank 0 has zeroed it */
+    MPI_Barrier(ws->comm);
+    MPI_Win_lock_all(0, ws->win);
+}
+
+/* Answer every pending steal request with the upper half of our range */
+void ws_serve(WorkSteal *ws) {
+    int pending;
+    MPI_Status status;
+    MPI_Iprobe(MPI_ANY_SOURCE, TAG_REQ, ws->comm, &pending, &status);
+    while (pending) {
+        int thief = status.MPI_SOURCE;
+        long range[2] = {0, 0};
+        MPI_Recv(NULL, 0, MPI_INT, thief, TAG_REQ, ws->comm, MPI_STATUS_IGNORE);
+        long give = (ws->hi - ws->lo) / 2;
+        if (give >= ws->min_steal) {
+            range[0] = ws->hi - give;
+            range[1] = ws->hi;
+            ws->hi -= give;
+        }
+        MPI_Send(range, 2, MPI_LONG, thief, TAG_REPLY, ws->comm);
+        if (range[1] > range[0] && ws->lend) ws->lend(ws->ctx, thief, range[0], range[1]);
+        MPI_Iprobe(MPI_ANY_SOURCE, TAG_REQ, ws->comm, &pending, &status);
+    }
+}
+
+void ws_finished(WorkSteal *ws, long units) {
+    ws->done += units;
+    MPI_Accumulate(&units, 1, MPI_LONG, 0, 0, 1, MPI_LONG, MPI_SUM, ws->win);
+    MPI_Win_flush(0, ws->win);
+}
+
+static long completed(WorkSteal *ws) {
+    long value;
+    MPI_Fetch_and_op(NULL, &value, MPI_LONG, 0, 0, MPI_NO_OP, ws->win);
+    MPI_Win_flush(0, ws->win);
+    return value;
+}
+
+/* With the owned range empty: -1 once every unit is done, otherwise ask one
+   random victim, serving other thieves while waiting, and return the
+   victim with the granted (possibly empty) range in [*lo, *hi) */
+int ws_steal(WorkSteal *ws, long *lo, long *hi) {
+    *lo = *hi = 0;
+    if (ws->size == 1 || completed(ws) == ws->total) return -1;
+
+    int victim = rand_r(&ws->seed) % (ws->size - 1);
+    if (victim >= ws->rank) victim++;
+
+    MPI_Request req;
+    MPI_Isend(NULL, 0, MPI_INT, victim, TAG_REQ, ws->comm, &req);
+
+    long range[2];
+    int arrived = 0;
+    while (!arrived) {
+        ws_serve(ws);
+        MPI_Iprobe(victim, TAG_REPLY, ws->comm, &arrived, MPI_STATUS_IGNORE);
+    }
+    MPI_Recv(range, 2, MPI_LONG, victim, TAG_REPLY, ws->comm, MPI_STATUS_IGNORE);
+    MPI_Wait(&req, MPI_STATUS_IGNORE);
+
+    if (range[1] > range[0]) {
+        *lo = range[0];
+        *hi = range[1];
+        ws->steals++;
+    }
+    return victim;
+}
+
+/* No steal request of ours is in flight any more; keep answering the others
+   (with empty ranges) until every rank has reached this point */
+void ws_drain(WorkSteal *ws) {
+    MPI_Request barrier;
+    int all_done = 0;
+    MPI_Ibarrier(ws->comm, &barrier);
+    while (!all_done) {
+        ws_serve(ws);
+        MPI_Test(&barrier, &all_done, MPI_STATUS_IGNORE);
+    }
+    MPI_Win_unlock_all(ws->win);
+}
+
+void ws_free(WorkSteal *ws) {
+    MPI_Win_free(&ws->win);
+    MPI_Comm_free(&ws->comm);
+}
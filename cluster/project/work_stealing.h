@@ -0,0 +1,68 @@
+/*
+ * Decentralized work stealing over a range of work units
+ * -------------------------------------------------------
+ *  - Purpose: One implementation of the steal protocol shared by the
+ *    drivers that balance a [lo, hi) range of independent units (jobs in
+ *    batched_matmul.c, rows in block_rows_algorithm.c), so that its
+ *    termination logic lives in one place.
+ *  - Features:
+ *      • Each rank owns a range and takes units from its lower end
+ *      • An idle rank asks a random victim for work; the victim answers at
+ *        its next ws_serve() (MPI_Iprobe) with the upper half of its
+ *        remaining range, or an empty range if that is below min_steal
+ *      • Optional lend hook, called on the victim for every granted range,
+ *        for drivers whose units carry data (e.g. rows of A)
+ *      • Termination detected with a single completed-units counter in an
+ *        MPI RMA window on rank 0 (MPI_Accumulate / MPI_Fetch_and_op),
+ *        then an MPI_Ibarrier during which late requests get empty ranges
+ *
+ *  Usage
+ *  -----
+ *      ws_init(&ws, comm, lo, hi, total, min_steal);
+ *      for (;;) {
+ *          while (ws.lo < ws.hi) { claim units from ws.lo, compute them,
+ *                                  ws_finished(&ws, count); ws_serve(&ws); }
+ *          if (ws_steal(&ws, &lo, &hi) < 0) break;
+ *          ... compute [lo, hi) or make it the owned range ...
+ *      }
+ *      ws_drain(&ws);
+ *      ws_free(&ws);
+ *
+ *  Notes
+ *  -----
+ *      • Claim units (advance ws.lo) before computing them so that they
+ *        cannot be lent meanwhile.
+ *      • The protocol runs on a duplicate of comm: driver messages on comm,
+ *        including the lend hook's, cannot match its tags.
+ *      • ws_init, ws_drain and ws_free are collective over comm.
+ */
+
+#ifndef WORK_STEALING_H
+#define WORK_STEALING_H
+
+#include <mpi.h>
+
+typedef struct WorkSteal {
+    MPI_Comm comm;              /* private duplicate of the driver's comm */
+    int rank, size;
+    long lo, hi;                /* units still owned                      */
+    long total;                 /* units over all ranks                   */
+    long min_steal;             /* smallest range worth lending           */
+    long done;                  /* units completed by this rank           */
+    int steals;                 /* successful steals by this rank         */
+    unsigned seed;              /* victim choice                          */
+    MPI_Win win;                /* completed-units counter on rank 0      */
+    long *counter;
+    /* called on the victim after granting [lo, hi) to thief */
+    void (*lend)(void *ctx, int thief, long lo, long hi);
+    void *ctx;
+} WorkSteal;
+
+void ws_init(WorkSteal *ws, MPI_Comm comm, long lo, long hi, long total, long min_steal);
+void ws_serve(WorkSteal *ws);
+void ws_finished(WorkSteal *ws, long units);
+int ws_steal(WorkSteal *ws, long *lo, long *hi);
+void ws_drain(WorkSteal *ws);
+void ws_free(WorkSteal *ws);
+
+#endif